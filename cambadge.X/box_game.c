@@ -46,8 +46,9 @@ Program flow:
 
 #define array_size (((BOX_board_bottom+8)/8) * (BOX_board_right + 1))
 
-#define default_fg_color	primarycol[1]
-#define default_bg_color	primarycol[0]
+// colours are canvas palette indexes, palette set to primarycol[]
+#define default_fg_color	1
+#define default_bg_color	0
 
 unsigned short *tetrapuzz_cursorbuf = (unsigned short *) &cambuffer_s[128*128];
 
@@ -311,6 +312,7 @@ unsigned char cur_piece = 0;	//Index for BOX_reference
 unsigned char rotate = 0;		//Index for piece rotation
 static unsigned char score = 0;		//Track the number of rows completed
 static unsigned char game_over = 0;
+static unsigned int frametime, framemax = 0; // core timer ticks for last and slowest screen update
 
 //Messages
 const unsigned char message1[] = { "Tetrapuzz!" };
@@ -337,23 +339,13 @@ unsigned char BOX_get_score(void) {
 void BOX_draw(unsigned char X, unsigned char Y, unsigned char color)
 {
   //Draw box
-  unsigned int row, col;
-  for (row = Y*BOX_multiplier; row < (Y*BOX_multiplier)+BOX_multiplier; row++) {
-    for (col = X*BOX_multiplier; col < (X*BOX_multiplier)+BOX_multiplier; col++) {
-      cambuffer_s[col+(row*(BOX_multiplier*(BOX_board_right+1)))] = default_fg_color; //color;
-    }
-  }
+  canvas_fill(X*BOX_multiplier, Y*BOX_multiplier, BOX_multiplier, BOX_multiplier, default_fg_color); //color;
 }
 
 void BOX_erase(unsigned char X, unsigned char Y)
 {
   //Erase box
-  unsigned int row, col;
-  for (row = Y*BOX_multiplier; row < (Y*BOX_multiplier)+BOX_multiplier; row++) {
-    for (col = X*BOX_multiplier; col < (X*BOX_multiplier)+BOX_multiplier; col++) {
-      cambuffer_s[col+(row*(BOX_multiplier*(BOX_board_right+1)))] = default_bg_color;
-    }
-  }
+  canvas_fill(X*BOX_multiplier, Y*BOX_multiplier, BOX_multiplier, BOX_multiplier, default_bg_color);
 }
 
 void BOX_pregame(void)
@@ -367,9 +359,12 @@ void BOX_start_game(void)
   score = 0; //Reset score
   game_over = 0;
   
-  //Fclear frame buffer
+  //Clear screen, and canvas for the board. Only the squares that change get sent from now on
   unsigned int i;
-  for (i=0; i<128*128; i++) cambuffer_s[i] = default_bg_color;
+  printf(cls);
+  canvas_init(0, 0, BOX_multiplier*(BOX_board_right+1), 128, cambuffer);
+  for (i=0; i<16; i++) palette[i] = primarycol[i];
+  framemax = 0;
    
   for (i=0; i<array_size; i++) { BOX_location[i] = 0x00; }
 
@@ -530,7 +525,7 @@ void BOX_rotate(unsigned char direction)
 	  BOX_store_loc();
 	  BOX_write_piece();
   }
-  BOX_update_screen;
+  BOX_update_screen();
 }
 
 
@@ -577,7 +572,6 @@ void BOX_clear_piece(void)  //Clears piece from display
 
 void BOX_rewrite_display(unsigned char fgcolor, unsigned char bgcolor)	//Rewrites entire playing area
 {
-  printf(cls);
   unsigned char cols, rows;
   for (cols=0; cols<=BOX_board_right; cols++)
   {
@@ -590,7 +584,11 @@ void BOX_rewrite_display(unsigned char fgcolor, unsigned char bgcolor)	//Rewrite
 }
 
 void BOX_update_screen(void) {
-  dispimage(0,0,BOX_multiplier*(BOX_board_right+1), 128, img_rgb565, (char *) cambuffer);
+  frametime = _CP0_GET_COUNT();
+  canvas_flush();
+  frametime = _CP0_GET_COUNT() - frametime;
+  if (frametime > framemax) framemax = frametime;
+  printf(tabx14 taby2 "Frame" tabx14 taby3 "%4duS" tabx14 taby4 "%4duS", frametime / (clockfreq / 2000000), framemax / (clockfreq / 2000000));
 }
 
 void BOX_spawn(void)
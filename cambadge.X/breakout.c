@@ -17,19 +17,23 @@
 #define BALLXSTARTSPEED 200
 #define BALLYSTARTSPEED 200
 
-#define GAMECLOCKDIVISOR  24
+#define BALLRATE 300 // added to the move clocks each tick. Ball moves a pixel each time a clock passes its speed value
 
 #define PADDLESIZEX 36
 #define PADDLESIZEY 3
 #define PADDLESPEEDCHANGINGAREA 12
 #define PADDLETOPY  124
 #define PADDLESTARTX 32
-#define PADDLECOLOR primarycol[1]
+#define PADDLECOLOR 1
 #define PADDLESPEEDSTART 3
 #define SPEEDINCREMENT 20
 
-#define BACKGROUNDCOLOR primarycol[0]
-#define BALLCOLOR primarycol[2]
+// colours are canvas palette indexes, palette set to primarycol[]
+#define BACKGROUNDCOLOR 0
+#define BALLCOLOR 2
+
+#define SPR_BALL 0
+#define SPR_PADDLE 1
 
 #define BRICKSIZEX  8
 #define BRICKSIZEY  4
@@ -44,6 +48,16 @@ typedef struct binPix {
   unsigned char monoPixel : 1;
 } binaryPixel;
 
+const unsigned char ballimg[BALLSIZE*BALLSIZE] = { // corners clear
+  0, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, 0,
+  BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR,
+  BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR,
+  BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR,
+  BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR,
+  0, BALLCOLOR, BALLCOLOR, BALLCOLOR, BALLCOLOR, 0
+};
+unsigned char paddleimg[PADDLESIZEX*PADDLESIZEY];
+
 
 //Protoypes
 void moveballX(char *xp, unsigned char x_dir);
@@ -217,32 +231,24 @@ void newballspeed(unsigned char ballX, unsigned char paddleX, unsigned char dir_
 
 void drawboard(void) {
   //FIXME
-  plotblock(0,8,128,4,primarycol[3]);
-  plotblock(0,12,128,4,primarycol[4]);
-  plotblock(0,16,128,4,primarycol[5]);
-  plotblock(0,20,128,4,primarycol[6]);
-  plotblock(0,24,128,4,primarycol[7]);
-  plotblock(0,28,128,4,primarycol[1]);
+  canvas_fill(0,8,128,4,3);
+  canvas_fill(0,12,128,4,4);
+  canvas_fill(0,16,128,4,5);
+  canvas_fill(0,20,128,4,6);
+  canvas_fill(0,24,128,4,7);
+  canvas_fill(0,28,128,4,1);
 }
 
 void drawpaddle(unsigned char x, unsigned char y) {
-  plotblock(x ,y , PADDLESIZEX, PADDLESIZEY, PADDLECOLOR);
-}
-
-void erasepaddle(unsigned char x, unsigned char y) {
-  plotblock(x ,y , PADDLESIZEX, PADDLESIZEY, BACKGROUNDCOLOR);
-}
-
-void drawball(unsigned char x, unsigned char y, unsigned short color) {
-  plotblock(x, y, BALLSIZE, BALLSIZE, color);
+  canvas_sprite(SPR_PADDLE, x, y, PADDLESIZEX, PADDLESIZEY, paddleimg);
 }
 
-void eraseball(unsigned char x, unsigned char y) {
-  plotblock(x, y, BALLSIZE, BALLSIZE, BACKGROUNDCOLOR);
+void drawball(unsigned char x, unsigned char y) {
+  canvas_sprite(SPR_BALL, x, y, BALLSIZE, BALLSIZE, ballimg);
 }
 
 void erasebrick(unsigned char x, unsigned char y) {
-  plotblock(x, y, BRICKSIZEX, BRICKSIZEY, BACKGROUNDCOLOR);
+  canvas_fill(x, y, BRICKSIZEX, BRICKSIZEY, BACKGROUNDCOLOR);
 }
 
 void movepaddle(char *paddleX, signed char paddleSpeed) {
@@ -255,17 +261,15 @@ void movepaddle(char *paddleX, signed char paddleSpeed) {
     //We've reached the right side of the screen so don't move paddle
     return;
   }
-  erasepaddle(*paddleX, PADDLETOPY);
   *paddleX += paddleSpeed;
-  drawpaddle(*paddleX, PADDLETOPY);
 }
 
 char* breakout(unsigned int action)
 {
   static unsigned int state;
-  static unsigned char gameclock;
-  static unsigned char moveclockX;
-  static unsigned char moveclockY;
+  static unsigned int moveclockX;
+  static unsigned int moveclockY;
+  static unsigned int frametime, frametotal, framemax, frames; // core timer ticks from start of tick to frame on display
 
   static signed char x;
   static signed char y;
@@ -277,6 +281,7 @@ char* breakout(unsigned int action)
   static binaryPixel blocks[BRICKSWIDE*BRICKSHIGH];
   
   static signed char paddleX;
+  unsigned int i;
   
   switch(action) {
      case act_name : return("BREAKOUT");
@@ -301,7 +306,9 @@ char* breakout(unsigned int action)
  
  switch(state) {
      case s_start :
-       printf(cls);
+       canvas_init(0, 0, dispwidth, dispheight, cambuffer);
+       for (i=0; i<16; i++) palette[i] = primarycol[i];
+       for (i=0; i<PADDLESIZEX*PADDLESIZEY; i++) paddleimg[i] = PADDLECOLOR;
        x = BALLXSTART;
        y = BALLYSTART;
        x_dir = 1;
@@ -309,15 +316,15 @@ char* breakout(unsigned int action)
        speed_x = BALLXSTARTSPEED;
        speed_y = BALLYSTARTSPEED;
        paddleX = PADDLESTARTX;
-       gameclock = 0;
        moveclockX = 0;
        moveclockY = 0;
+       frametotal = framemax = frames = 0;
        
-       unsigned char i;
        for (i=0; i<96; i++) blocks[i].monoPixel = 1;
        drawboard();
        drawpaddle(paddleX, PADDLETOPY);
-       drawball(x, y, BALLCOLOR);
+       drawball(x, y);
+       canvas_flush();
        state=s_run;
        break;
        
@@ -325,49 +332,51 @@ char* breakout(unsigned int action)
        //printf(tabx6 taby0 whi "X %5d Y %5d",accx,accy);
        //printf(tabx6 taby0 whi "%5d",gameclock);
         
-        if (tick) {
-           if (accx >= 1000) movepaddle(&paddleX, (unsigned char) (accx/1000)); //Right
-           else if (accx <= -1000) movepaddle(&paddleX, abs((unsigned char) (accx/1000))); //Left
-        }
-        
-        if (++gameclock > GAMECLOCKDIVISOR) {
-          gameclock = 0;
-          ++moveclockX;
-          ++moveclockY;
-        }
+        if (!tick) break; // one frame per tick, however fast the polling
+        frametime = _CP0_GET_COUNT();
         
-       
-       //Timer ready to move X
-        if (moveclockX > speed_x) {
-          moveclockX = 0;
+        if (accx >= 1000) movepaddle(&paddleX, (unsigned char) (accx/1000)); //Right
+        else if (accx <= -1000) movepaddle(&paddleX, abs((unsigned char) (accx/1000))); //Left
         
-          eraseball(x, y); //Erase previous position
-          moveballX(&x, x_dir);
-          state = checkcollideX(x, y, &x_dir, blocks);
-          drawball(x, y, BALLCOLOR); //Draw new position        
-        }
+        moveclockX += BALLRATE * tick;
+        moveclockY += BALLRATE * tick;
+        while ((state == s_run) && ((moveclockX > speed_x) || (moveclockY > speed_y))) {
+          //Timer ready to move X
+          if (moveclockX > speed_x) {
+            moveclockX -= speed_x;
+            moveballX(&x, x_dir);
+            state = checkcollideX(x, y, &x_dir, blocks);
+          }
         
-        if (state == s_win) break;
+          if (state == s_win) break;
         
-        if (moveclockY > speed_y) {
-          moveclockY = 0;
-          
-          //Move the ball on Y axis
-          eraseball(x, y);
-          moveballY(&y, y_dir);
-          state = checkcollideY(x, y, x_dir, &y_dir, &speed_x, paddleX, blocks);
-          drawball(x, y, BALLCOLOR); //Draw new position
+          if (moveclockY > speed_y) {
+            moveclockY -= speed_y;
+            //Move the ball on Y axis
+            moveballY(&y, y_dir);
+            state = checkcollideY(x, y, x_dir, &y_dir, &speed_x, paddleX, blocks);
+          }
         }
         
+        drawpaddle(paddleX, PADDLETOPY);
+        drawball(x, y);
+        canvas_flush();
+        
+        frametime = _CP0_GET_COUNT() - frametime;
+        frametotal += frametime;
+        if (frametime > framemax) framemax = frametime;
+        ++frames;
         break;
  
      case s_gameover : 
        printf(tabx6 taby6 whi "Game Over");
+       printf(tabx2 taby8 "Frame avg %4duS" tabx2 taby9 "      max %4duS", frametotal / frames / (clockfreq / 2000000), framemax / (clockfreq / 2000000));
        if(butpress) state=s_start;
        break;
        
      case s_win:
        printf(tabx6 taby6 whi "You Win!");
+       printf(tabx2 taby8 "Frame avg %4duS" tabx2 taby9 "      max %4duS", frametotal / frames / (clockfreq / 2000000), framemax / (clockfreq / 2000000));
        if(butpress) state=s_start;
        break;
  
@@ -27,11 +27,11 @@ char* browser(unsigned int action) {
     unsigned i, j, y;
 
     static unsigned int brstate = s_startbrowse;
-    static unsigned int brscroll, brsel, brlast, brnfiles, brendflag, showtime, showtimer, shown;
+    static unsigned int brscroll, brsel, brlast, brnfiles, brendflag, showtime, showtimer, shown, seekframe;
 
     static char brname[15];
     static unsigned int brattrs, brlen, brtime, brtype;
-    static unsigned char shownames,showinfo;
+    static unsigned char shownames,showinfo,infodue;
 
     if (action == act_name) return ("BROWSER");
     else if (action == act_help) return ("Displays files on\nSD Card");
@@ -181,6 +181,12 @@ char* browser(unsigned int action) {
 
                     break;
 
+                case filetype('Q', 'O', 'I'):
+                    i = loadqoi(brname, 0);
+                    printf("%d x %d, %2d Bpp\n\n", avi_width, avi_height, avi_bpp * 8);
+                    if (i) printf("Error:\n%s", avierrors[i]);
+                    break;
+
                 case filetype('T', 'X', 'T'):
 
                     break;
@@ -227,6 +233,7 @@ char* browser(unsigned int action) {
                     PR2 = i;
                     TMR2 = 0;
                     IFS0SET = _IFS0_T2IF_MASK; // force first
+                    aviplay_start();
                     brstate = s_aviplaying;
                     printf(bot butcol "Pause    Delete  Back" top tabx18 "Off");
                     showinfo=1;
@@ -244,6 +251,13 @@ char* browser(unsigned int action) {
                     printf(whi bot butcol tabx8 "Delete   Back");
                     break;
 
+                case filetype('Q', 'O', 'I'):
+                    printf(cls);
+                    i = loadqoi(brname, 2);
+                    if (i) printf(red "Error:\n%s" whi, avierrors[i]);
+                    else printf(whi bot butcol tabx8 "Delete   Back");
+                    break;
+
 
                 default:
                     printf(cls "Don't know what to\ndo with that filetype");
@@ -279,10 +293,31 @@ char* browser(unsigned int action) {
 
             break;
 
-        case s_avipause:
+        case s_avipause: // step, scrub and jump through the index
+            j = avi_shown;
+            i = aviplay(0); // shows a frame seeked to once it's read, then reads the one after ready to play on
+            if (avi_shown != j) infodue = 1;
+            if (infodue && !oled_busy && (avi_height <= 96)) {
+                if (showinfo) printf(top yel "%4d/%-4d %3d%%   ", avi_framenum, avi_frames, avi_framenum * 100 / avi_frames);
+                infodue = 0;
+            }
+            if (i) {
+                FSfclose(fptr);
+                printf(cls red "Play Error %s" whi, avierrors[i]);
+                brstate = s_ibwait;
+                break;
+            }
             if (!butpress) break;
+            if (butpress & (but2 | but3 | but4)) {
+                j = (reptimer >= reptime - reprate) ? avi_frames / 50 + 1 : 1; // auto-repeating, so scrub 2% at a time
+                if (butpress & but2) seekframe += avi_frames - j % avi_frames;
+                if (butpress & but3) seekframe += j;
+                if (butpress & but4) seekframe = (seekframe * 10 / avi_frames + 1) % 10 * avi_frames / 10; // next 10% mark
+                aviseek(seekframe %= avi_frames);
+                break;
+            }
             if (butpress & but1) {
-                printf(bot butcol "Pause");
+                printf(bot butcol "Pause    Delete  Back" top tabx17 " Off");
                 butpress = 0;
             } // avoid pause loop
             // drop back into playing to other button functions work
@@ -296,7 +331,9 @@ char* browser(unsigned int action) {
             } //delete
             if (butpress & but1) {
                 brstate = s_avipause;
-                printf(bot butcol inv "Pause" inv);
+                seekframe = avi_framenum;
+                infodue = 1;
+                printf(bot butcol inv "Play" inv "      " larr "       " rarr top tabx17 "+10%%");
                 break;
             }
             if(butpress & but4) {showinfo^=1;printf(cls); break;}
@@ -305,14 +342,19 @@ char* browser(unsigned int action) {
                 brstate = s_restartbrowse;
                 break;
             }
-            if (IFS0bits.T2IF == 0) break;
-            IFS0CLR = _IFS0_T2IF_MASK;
-
-            i = showavi();
-            if (avi_height <= 96) if(showinfo)  printf(top yel "%4d/%-4d %4ds", avi_framenum, avi_frames, avi_framenum * avi_frametime / 1000000);
+            i = IFS0bits.T2IF; // a frame period gone by
+            if (i) IFS0CLR = _IFS0_T2IF_MASK;
+            j = avi_shown;
+            i = aviplay(i);
+            if (avi_shown != j) infodue = 1;
+            // text waits for the display, so only once the frame has gone, to keep it overlapping the next read
+            if (infodue && !oled_busy && (avi_height <= 96)) {
+                if (showinfo) printf(top yel "%4ds %2dfps %4d drop", avi_framenum * avi_frametime / 1000000, avi_fps, avi_dropped);
+                infodue = 0;
+            }
             if (i) {
                 FSfclose(fptr);
-                printf(cls red "Play Error %s" whi);
+                printf(cls red "Play Error %s" whi, avierrors[i]);
                 brstate = s_ibwait;
                 break;
             }
@@ -63,7 +63,10 @@ application const apps[] = {applist}; // list of function pointers to applicatio
 void main(void) {
     unsigned int i, state, dispowerdown = 0;
     unsigned int powerbuttimer = 0, mounttimer = 0; // power button-down timer, auto poweroff timer, card detect debounce timer
-    unsigned int y, scroll, appnum = 0; // menu display
+    unsigned int y, scroll, appnum = 0, laststatus = 0; // menu display
+#if spistats==1
+    unsigned int statticks = 0, sx, sy, sfg, sbg;
+#endif
     static uint64_t previous_time = 0;
 
     inithardware();
@@ -108,6 +111,22 @@ void main(void) {
             previous_time = micros();
             readbatt(); // read battery voltage
             readbuttons();
+#if spistats==1
+            statticks += tick;
+            if (statticks >= 50) { // show average, leaving app's cursor & colours as they were
+                i = oled_spibytes / statticks;
+                sx = dispx;
+                sy = dispy;
+                sfg = fgcol;
+                sbg = bgcol;
+                printf(tabx16 taby0 whi "%5d", i);
+                dispx = sx;
+                dispy = sy;
+                fgcol = sfg;
+                bgcol = sbg;
+                oled_spibytes = statticks = 0; // not counting our own print
+            }
+#endif
 
             i = accx; // previous accx for change detect
             acc_read();
@@ -155,6 +174,7 @@ void main(void) {
                 if (cardmounted) {
                     state = s_restart;
                     if (!openavi("splash.avi")) { // splash vid present
+                        aviplay_start();
                         state = s_splashavi;
                         break;
                     }
@@ -208,6 +228,8 @@ void main(void) {
 #endif
                 led1_off;
                 dispuart = 0;
+                dispconsole = 0;
+                dispfont(0);
 
                 printf(whi cls version bot butcol "  " uarr "         " darr "      Go");
 
@@ -217,6 +239,7 @@ void main(void) {
 
 #define maxy 7   // number of apps in menu
             case s_showmenu:
+                laststatus = ~0; // force status redraw
                 if (napps > maxy && scroll + maxy < napps) printf(tabx18 taby8 whi "...");
                 else printf(tabx18 taby8 whi "   ");
                 printf(whi tabx0 taby2);
@@ -240,12 +263,15 @@ void main(void) {
 
             case s_waitmenu: // wait for button press
                 if (!tick) break;
-                // following prints done every tick - not efficient but we've nothing else to do
-                printf(tabx12 taby0 whi);
-                printf(cardmounted ? sdcd : " "); // SD card symbol
-                // display battery voltage
-                printf(battlevel > batthresh1 ? grn : battlevel < batthresh2 ? red : yel); //select colour
-                printf(tabx13 taby0 bat "%c%d.%02dV", dispowerdown ? 0x60 : ' ', battlevel / 1000, (battlevel % 1000) / 10);
+                i = battlevel / 10 | cardmounted << 16 | dispowerdown << 17; // what's shown
+                if (i != laststatus) { // only redraw when changed
+                    laststatus = i;
+                    printf(tabx12 taby0 whi);
+                    printf(cardmounted ? sdcd : " "); // SD card symbol
+                    // display battery voltage
+                    printf(battlevel > batthresh1 ? grn : battlevel < batthresh2 ? red : yel); //select colour
+                    printf(tabx13 taby0 bat "%c%d.%02dV", dispowerdown ? 0x60 : ' ', battlevel / 1000, (battlevel % 1000) / 10);
+                }
 
                 if (!butpress) break;
 
@@ -278,7 +304,7 @@ void main(void) {
                 if (butstate & powerbut) break; // wait til button release
                 // will not normally be seen, but will if power override link is fitted
                 printf(cls taby4 grey "Awaiting Powerdown\n\n Button 5:reset");
-                cam_enable(cammode_off);
+                cam_enable(cammode_powerdown);
 
 
                 led1_off;
@@ -28,12 +28,20 @@
 #define batthresh2 2200 // red bat thresh, mV
 
 #define debug_dma 0 // =1 to enable PMRD signal on pin 11 to see cam DMA reads. SD card can't be used if enabled
+#define spistats 0 // =1 to show OLED SPI bytes per tick ( averaged over 50 ticks) top right, to check display efficiency of apps
+#define recordtiming 0 // =1 to show ms per frame spent writing AVI frames to card, camera app
+#define mjpg_quality 75 // JPEG quality 1-100 for MJPG AVIs recorded by the camera app. 75 makes frames around a tenth of their raw size
+#define avi_readchunk 2048 // bytes read per aviplay call. Smaller keeps buttons and frame timing finer, larger has less overhead
+#define avi_seekpoints 64 // AVI index entries kept for seeking, 4 bytes each. Beyond this many x32 frames seeks read more of the index
+#define isrtiming 0 // =1 to measure worst-case camera hsync/DMA ISR times into cam_hsmax/cam_dmamax, shown in camera app
+#define camchaindma 1 // =1 to use DMA1 to reload line destinations, so hsync int only restarts DMA0 and no per-line DMA int
 
 //============================F==============================================
 
 // RAM buffers
 #define cambufsize (dispwidth*dispheight*3+256) // size of image buffer, to fit rgb888 plus a little overlap
 #define hbuflen 1024 // size of buffer used for pallette and avi/bmp header noodling, also buffer for NVM data
+#define con_lines 40 // console scrollback, lines of text kept. Costs 2 bytes per character cell ( 21 per line), plus the same for the 13 lines on screen. 0 for none
 #define rxbufsize 256 // serial control rx buffer size
 
 #define nvm_addr 0x1D007C00 // flash address of NV memory
@@ -62,20 +70,47 @@
 #define camopt_refclk_4 0x40
 #define camopt_refclk_5 0x60
 #define camopt_double 0x80   // two-byte DMA cell, for RGB565 or highest speed mono
+#define camopt_sxga 0x100 // =1 for SXGA 1280x1024 ( overrides camopt_vga)
 
 //cam_grabenable options
 
 #define camen_start 1 // start and exit immediately
 #define camen_grab 2 // enable, grab one frame,stop
+#define camen_ring 3 // continuous grab into frame ring, cambuflen = slot length. Use cam_acquire_frame/cam_release_frame
+
+// frame ring
+
+#define camring_maxslots 4 // max slots in frame ring. Actual number limited by what fits in cambuffer ( 4 for 128x96 mono)
+#define camslot_none 0xff // no slot currently being filled
+
+#define camlineq_len 16 // line queue entries, must be power of 2
+#define camlinetab_len 128 // max lines for chained-DMA capture, taller frames use per-line ISR capture
+
+// luminance histogram, gathered by line DMA int as frames arrive
+
+#define camhist_bins 64 // 64 as RGB565 green is 6 bits, mono uses top 6 bits of Y
+#define camhist_xstep 4 // sample every 4th pixel of a histogram line
+#define camaec_expmax 0x7c // software AEC max exposure, in 4-row units ( 0x10/0xA1 regs are AEC[15:2]). 0x7c = 496 rows, just under the ~500 row frame so frame rate doesn't drop
+#define camaec_gainmax 128 // software AEC max gain, 1/16ths ( 128=8x)
+
+#define camslot_free 0 // slot states for cam_slotstate[]
+#define camslot_filling 1
+#define camslot_ready 2
+#define camslot_inuse 3
 
 // camera modes for camenable()
 
-#define cammode_off 0
+#define cammode_off 0 // warm standby - sensor keeps its set-up and exposure/AWB state for quick restart
+#define cammode_powerdown 0x80 // standby, and force full reset on next enable. For power-down and recovery
 #define cammode_128x96_z1 1
 #define cammode_128x96_z2 2
 #define cammode_128x96_z1_mono 3
 #define cammode_128x96_z2_mono 4
 #define cammode_128x96_z4_mono 5
+// still-only modes, too big for cambuffer so captured through a wrapping line FIFO
+#define cammode_vga_mono 6
+#define cammode_vga_rgb 7
+#define cammode_sxga_mono 8
 
 typedef struct {
     unsigned short xpixels;
@@ -87,10 +122,11 @@ typedef struct {
     unsigned short flags;
 } camconftype;
 
-#define ncammodes 6
+#define ncammodes 6 // live view modes, cycled through by apps
+#define ncammodes_all 9 // including still-only modes
 #define fastcolzoom 1 // faster x2 colur zoom, timing might be a bit sketchy
 
-const camconftype camconfig[ncammodes]={
+const camconftype camconfig[ncammodes_all]={
 {128,96,4,2,0,0,0},
 {128,96,4,2,30,24,camopt_refclk_2 | camopt_double },
 #if fastcolzoom==1
@@ -100,11 +136,15 @@ const camconftype camconfig[ncammodes]={
 #endif
 {128,96,4,2,30,24, camopt_refclk_2 | camopt_mono | camopt_swap },
 {128,96,2,1,96,73,camopt_refclk_2 | camopt_mono | camopt_swap },
-{128,96,2,1,224,194,camopt_refclk_3 | camopt_vga | camopt_mono | camopt_swap }
-
+{128,96,2,1,224,194,camopt_refclk_3 | camopt_vga | camopt_mono | camopt_swap },
+// stills. widths leave a few PCLKs spare at the end of the row for the 2 extra DMA reads, and keep BMP rows a multiple of 4 bytes
+{632,472,2,1,2,4,camopt_refclk_3 | camopt_vga | camopt_mono | camopt_swap },
+{316,236,4,2,2,4,camopt_refclk_3 | camopt_vga | camopt_clkphase | camopt_double },
+{1272,1016,2,1,2,4,camopt_refclk_3 | camopt_sxga | camopt_mono | camopt_swap }
 };
 
-const char* camnames[ncammodes] = {"", "128x96 x1 RGB", "128x96 x2 RGB", "128x96 x1 B/W", "128x96 x2 B/W", "128x96 x4 B/W"};
+const char* camnames[ncammodes_all] = {"", "128x96 x1 RGB", "128x96 x2 RGB", "128x96 x1 B/W", "128x96 x2 B/W", "128x96 x4 B/W",
+"632x472 B/W", "316x236 RGB", "1272x1016 B/W"};
 
 //_________________________________________________________________hardwareish stuff
 
@@ -167,6 +207,9 @@ const char* camnames[ncammodes] = {"", "128x96 x1 RGB", "128x96 x2 RGB", "128x96
 #define img_rgb888 3
 #define img_revscan 0x04 // reverse vertical scan direction
 #define img_vdouble 0x08 // double vertical pixels
+#define img_nowait 0x100 // return as soon as DMA transfer started. Image must stay unchanged until oled_busy clears
+#define img_diff 0x200 // only send 8x8 tiles that have changed since last time this area was displayed
+#define img_smooth 0x400 // dispscaled: average 2x2 source pixels at each sample point instead of nearest pixel
 #define img_skip1 0x10 // skip alternate pixels for downsampling
 #define img_skip2 0x20
 #define img_skip3 0x30
@@ -178,6 +221,11 @@ const char* camnames[ncammodes] = {"", "128x96 x1 RGB", "128x96 x2 RGB", "128x96
 #define img_skip9 0x90
 #define img_skip10 0xa0
 
+// game canvas
+
+#define canvas_maxsprites 8 // sprites drawn over the canvas background, in number order
+#define canvas_clear 0 // sprite pixel value that lets what's under it show through
+
 
 //________________________________________ text
 
@@ -204,6 +252,9 @@ const char* camnames[ncammodes] = {"", "128x96 x1 RGB", "128x96 x2 RGB", "128x96
 #define lf "\x0a" // CR and LF
 #define cr "\x0d"  // CR only
 #define grey "\x0e" // grey  fg colour
+#define fnt6x8 "\x10" // fonts, until changed. Line spacing follows the font, tabs stay on the 6x8 grid
+#define fnt12x16 "\x11"
+#define fntnum "\x12" // 24x32 digits etc. for readouts
 
 //special display characters
 // add more below 0x18 and update startchar in font6x8.inc
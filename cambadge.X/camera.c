@@ -15,11 +15,30 @@
 #define s_waitavi 10
 #define s_aviloop 11
 #define s_avierr 12
+#define s_hirestart 13
+#define s_hiressettle 14
+#define s_hirespass 15
+#define s_hiresrun 16
+#define s_burststart 17
+#define s_burstrun 18
+#define s_burstsave 19
+
+// what the trigger does
+#define vm_bmp 0
+#define vm_avi 1
+#define vm_mjpg 2 // AVI with JPEG compressed frames, so less to write per frame
+#define vm_qoi 3 // stills as lossless QOI, smaller than BMP
+#define vm_burst 4 // consecutive frames into RAM at sensor rate, saved to BMPs afterwards
+#define vm_vga 5 // full-resolution stills, streamed to file through a line FIFO
+#define vm_sxga 6
+
+#define hirestep 4 // lines per line-queue entry for hi-res stills
 
 
 #define ct_bmp 0
 #define ct_dir 1
 #define ct_avi 2
+#define ct_qoi 3
 
 
 char camname[12];
@@ -50,6 +69,12 @@ void docamname(unsigned int n, unsigned int ct) { // create a formatted filename
         camname[i++] = 'V';
         camname[i++] = 'I';
     }
+    if (ct == ct_qoi) {
+        camname[i++] = '.';
+        camname[i++] = 'Q';
+        camname[i++] = 'O';
+        camname[i++] = 'I';
+    }
 
     camname[i++] = 0;
 }
@@ -57,8 +82,15 @@ void docamname(unsigned int n, unsigned int ct) { // create a formatted filename
 char* camera(unsigned int action) {
     static unsigned int camstate = s_camstart;
     static unsigned int camfile = 0, camdir = 0, cam_cammode, vidmode = 0, frame;
-    static unsigned int rectime, explock,campage;
-    unsigned int i;
+    static unsigned int rectime, explock;
+    static unsigned char* mjpgbuf; // MJPG frames are encoded into the start of cambuffer, before the frame ring
+    static unsigned int mjpglen;
+    static unsigned int hiline, hififo, hilinebytes, hibpp, hipasses, hitimer; // hi-res still state
+    static unsigned int burstn, burstlen, burstsram, bursttaken, burstheld, burstsave, burstt0, burstt1; // burst state
+    static unsigned char* burstframe[camring_maxslots]; // frames kept in ring after SRAM full, in capture order
+    unsigned int i, j, k;
+    unsigned char* frameptr;
+    frame_t camframe;
 
 
     if (action == act_name) return ("CAMERA");
@@ -83,9 +115,22 @@ char* camera(unsigned int action) {
             if (explock) printf(inv "ExLock" inv);
             else printf("ExLock");
 
-            if (vidmode) printf(tabx14 hspace "BMP" hspace inv "AVI" inv);
-            else printf(tabx14 hspace inv "BMP" inv hspace "AVI");
-            printf(taby11 tabx0 yel "%s", camnames[cammode]);
+            switch (vidmode) {
+                case vm_bmp: printf(tabx14 hspace inv "BMP" inv hspace "AVI");
+                    break;
+                case vm_avi: printf(tabx14 hspace "BMP" hspace inv "AVI" inv);
+                    break;
+                case vm_mjpg: printf(tabx14 hspace inv "MJPEG" inv);
+                    break;
+                case vm_qoi: printf(tabx14 hspace inv " QOI " inv);
+                    break;
+                case vm_burst: printf(tabx14 hspace inv "BURST" inv);
+                    break;
+                case vm_vga: printf(tabx14 hspace inv " VGA " inv);
+                    break;
+                case vm_sxga: printf(tabx14 hspace inv "SXGA " inv);
+            }
+            printf(taby11 tabx0 yel "%s" tabx16 grey "%3dtx", camnames[cammode], cam_switchi2c); // I2C transactions for mode switch
             camstate = s_camlive;
             cam_grabenable(camen_start, 7, 0);
             led1_off;
@@ -114,7 +159,7 @@ char* camera(unsigned int action) {
             }
             if (butpress & but3) {
                 camfile = 0;
-                vidmode ^= 1;
+                if (++vidmode > vm_sxga) vidmode = vm_bmp;
                 camstate = s_camrestart;
             }
             if (butpress & but4) {
@@ -126,13 +171,18 @@ char* camera(unsigned int action) {
                 }
             }
             if (butpress & but5) {
-                camstate = vidmode ? s_camavistart : s_camgrab;
+                camstate = ((vidmode == vm_bmp) || (vidmode == vm_qoi)) ? s_camgrab : ((vidmode == vm_avi) || (vidmode == vm_mjpg)) ? s_camavistart : (vidmode == vm_burst) ? s_burststart : s_hirestart;
                 break;
             }
             if (!cam_newframe) break;
             if (camflags & camopt_mono) monopalette(0, 255);
             cam_newframe = 0; // clear now in case display takes longer than cam frame time
-            dispimage(0, 12, xpixels, ypixels, (camflags & camopt_mono) ? (img_mono | img_revscan) : (img_rgb565 | img_revscan), cambuffer + 8);
+            cam_frame(&camframe, cambuffer + 8);
+            dispframe(0, 12, camframe.width, camframe.height, &camframe, img_nowait | img_diff);
+#if isrtiming==1
+            i = oled_xfertime ? (oled_xfertime - oled_cputime)*100 / oled_xfertime : 0; // % of last display transfer given back to FG
+            printf(tabx0 taby11 whi "ISR %3d/%-3d OLED%3d%%", cam_hsmax * 2, cam_dmamax * 2, i); // worst-case hsync/DMA ISR, CPU cycles
+#endif
             break;
 
         case s_avierr:
@@ -161,7 +211,7 @@ char* camera(unsigned int action) {
                 if (i) FSfclose(fptr);
             } while (i);
 
-            fptr = FSfopen(camname, FS_WRITE);
+            fptr = FSfopen(camname, FS_WRITEPLUS); // finishavi reads MJPG chunk lengths back
             FSchdir("\\");
             if (fptr == NULL) {
                 printf(bot "Error FileOpen  " del del);
@@ -181,6 +231,7 @@ char* camera(unsigned int action) {
             avi_framelen = xpixels * ypixels*avi_bpp;
             avi_frames = 0;
             avi_frametime = 200000; // dummy for now
+            avi_quality = (vidmode == vm_mjpg) ? mjpg_quality : 0;
 
             if (startavi()) {
                 printf(bot "Error StartAVI  " del del);
@@ -188,8 +239,10 @@ char* camera(unsigned int action) {
                 break;
             }
 
-            cam_grabenable(camen_grab, 7, 0);
-            campage=0;
+            mjpgbuf = cambuffer;
+            mjpglen = avi_quality ? (avi_framelen / 2) & ~7 : 0; // still leaves room for 3 mono ring slots
+            cam_grabenable(camen_ring, mjpglen + 7, avi_framelen + 8); // frame ring, 8 bytes per slot for chunk header
+            if (avi_quality) avi_framelen = 0; // becomes the biggest frame written
             camstate = s_waitavi;
             break;
 
@@ -209,40 +262,35 @@ char* camera(unsigned int action) {
                     break;
                 }
 
-            if (cam_newframe == 0) break; //got a new frame ?
-
-            cam_grabenable(camen_grab,7+(campage?0:(avi_framelen+8)),0); // start grab to other page
+            frameptr = cam_acquire_frame(); //got a new frame ?
+            if (frameptr == 0) break;
             if (camflags & camopt_mono) monopalette(0, 255);
 
-            // add chunk header before image data
-            i=campage?(avi_framelen+8):0;
-            cambuffer[i++] = '0';
-            cambuffer[i++] = '0';
-            cambuffer[i++] = 'd';
-            cambuffer[i++] = 'c';
-            cambuffer[i++] = avi_framelen;
-            cambuffer[i++] = avi_framelen >> 8;
-            cambuffer[i++] = 0;
-            cambuffer[i++] = 0;
-
-            dispimage(0, 12, xpixels, ypixels, (camflags & camopt_mono) ? (img_mono | img_revscan) : (img_rgb565 | img_revscan), cambuffer + i);
-
-            if (avi_bpp == 1) flipcambuf(xpixels, ypixels, i); // mono AVIs have reverse scan direction
-
-
-            if (FSfwrite(&cambuffer[i-8], avi_framelen + 8, 1, fptr) == 0) {
+            cam_frame(&camframe, frameptr);
+            dispframe(0, 12, camframe.width, camframe.height, &camframe, 0);
+#if recordtiming==1
+            j = _CP0_GET_COUNT();
+#endif
+            if (avi_quality) i = writemjpgframe(&camframe, mjpgbuf, mjpglen);
+            else i = writeaviframe(&camframe); // flips & range-maps mono on the way out. RGB chunk header goes in the 8 bytes before the frame
+#if recordtiming==1
+            j = (_CP0_GET_COUNT() - j) / (clockfreq / 2000); // ms, core timer is clockfreq/2
+            printf(tabx0 taby10 grey "Write %3dms", j);
+#endif
+            if (avi_quality) printf(tabx13 taby10 grey "%6dB", i); // compressed frame size
+            cam_release_frame(frameptr);
+            if (i == 0) {
                 printf(bot "Error:WriteFrame" del del);
                 FSfclose(fptr);
                 cam_grabdisable();
                 break;
             }
 
-            campage=campage?0:1; // page swap
             i = TMR5;
             if (IFS0bits.T5IF) i += 0x10000; // rolled - assume only once
             rectime += (i * 256 / (clockfreq / 1000000)); // uS
 
-            printf(tabx0 taby11 yel "Frame %04d %4d secs", ++avi_frames, rectime / 1000000);
+            printf(tabx0 taby11 yel "Frame %04d %4ds" red "%3d", ++avi_frames, rectime / 1000000, cam_drops);
             TMR5 = 0;
             IFS0bits.T5IF = 0;
 
@@ -268,34 +316,242 @@ char* camera(unsigned int action) {
 
             i = 0;
             do { // find first unused filename
-                docamname(camfile++, ct_bmp);
+                docamname(camfile++, (vidmode == vm_qoi) ? ct_qoi : ct_bmp);
                 printf(bot "%-21s", camname);
                 fptr = FSfopen(camname, FS_READ);
                 i = (fptr != NULL);
                 if (i) FSfclose(fptr);
             } while (i);
 
-            if (!(camflags & camopt_mono)) conv16_24(xpixels * ypixels, 8); // RGB565 to 888
+            cam_frame(&camframe, cambuffer + 8);
 
             fptr = FSfopen(camname, FS_WRITE);
             FSchdir("\\"); // exit dir for easier tidyup if error
 
-            i = writebmpheader(xpixels, ypixels, (camflags & camopt_mono) ? 1 : 3);
+            i = (vidmode == vm_qoi) ? writeqoi(&camframe) : writebmp(&camframe);
+            FSfclose(fptr);
             if (i == 0) {
-                FSfclose(fptr);
-                printf("Err writing header" bot "OK");
+                printf("Err writing image" bot "OK");
                 camstate = s_camwait;
                 break;
             }
-            i = FSfwrite(&cambuffer[8], xpixels * ypixels * ((camflags & camopt_mono) ? 1 : 3), 1, fptr);
+
+
+            break;
+
+        case s_burststart: // grab frames into the ring at full rate, overflowing into SPI SRAM if fitted. Nothing touches the card until done
+            printf(bot whi);
+            camstate = s_camrestart; // default next state
+            if (!cardmounted) {
+                printf(inv"No Card         " inv del);
+                break;
+            }
+            burstlen = xpixels * ypixels * ((camflags & camopt_mono) ? 1 : 2);
+            burstsram = sram_probe() ? sram_size / burstlen : 0;
+            cam_grabenable(camen_ring, 7, burstlen + 8);
+            burstn = cam_nslots + burstsram;
+            bursttaken = burstheld = burstsave = 0;
+            hitimer = 0;
+            printf(bot red inv "BURST" inv whi " %d frames", burstn);
+            camstate = s_burstrun;
+            break;
+
+        case s_burstrun:
+            frameptr = cam_acquire_frame();
+            if (frameptr == 0) {
+                hitimer += tick;
+                if ((hitimer > 50) || (butpress & powerbut)) {
+                    cam_grabdisable();
+                    printf(bot "Capture failed   " del del);
+                    camstate = s_camrestart;
+                }
+                break;
+            }
+            hitimer = 0;
+            for (i = 0; &cambuffer[cam_slotaddr[i] + 1] != frameptr; i++); // find slot for its completion time
+            if (bursttaken++ == 0) burstt0 = cam_slottime[i];
+            burstt1 = cam_slottime[i];
+
+            if (bursttaken <= burstsram) { // copy out to SRAM and free the slot for the next frame
+                sram_write((bursttaken - 1) * burstlen, frameptr, burstlen);
+                cam_release_frame(frameptr);
+            } else burstframe[burstheld++] = frameptr; // SRAM full, keep the rest in the ring
+
+            printf(tabx0 taby11 yel "Frame %2d/%-2d" red "%3d", bursttaken, burstn, cam_drops);
+            if (bursttaken != burstn) break;
+
+            cam_grabdisable();
+            i = (burstt1 != burstt0) ? (burstn - 1)*(clockfreq / 2)*10 / (burstt1 - burstt0) : 0; // fps x10, core timer is clockfreq/2
+            j = cam_vsperiod ? (clockfreq / 2)*10 / cam_vsperiod : 0;
+            printf(bot whi "%2d.%dfps sensor %2d.%d", i / 10, i % 10, j / 10, j % 10);
+            camstate = s_burstsave;
+            break;
+
+        case s_burstsave: // one file per poll. SRAM frames first as they were captured first
+            if (burstsave == burstn) {
+                printf(tabx0 taby11 yel "%d saved" del del, burstn);
+                camstate = s_camrestart;
+                break;
+            }
+            i = FSchdir("\\CAMERA");
+            if (i) {
+                FSmkdir("CAMERA");
+                FSchdir("CAMERA");
+            }
+            i = 0;
+            do { // find first unused filename
+                docamname(camfile++, ct_bmp);
+                fptr = FSfopen(camname, FS_READ);
+                i = (fptr != NULL);
+                if (i) FSfclose(fptr);
+            } while (i);
+            printf(tabx0 taby11 yel "%-12s %2d/%-2d", camname, burstsave + 1, burstn);
+
+            fptr = FSfopen(camname, FS_WRITE);
+            FSchdir("\\");
+            if (fptr == NULL) {
+                printf(bot "Error FileOpen  " del del);
+                camstate = s_camrestart;
+                break;
+            }
+            hibpp = (camflags & camopt_mono) ? 1 : 3;
+            k = writebmpheader(xpixels, ypixels, hibpp);
+            j = burstlen / ypixels; // bytes per captured line
+            for (i = 0; k && (i != ypixels); i++) { // a line at a time, as RGB lines grow when converted and SRAM lines need a buffer
+                if (burstsave < burstsram) {
+                    frameptr = avibuf + 512;
+                    sram_read(burstsave * burstlen + i*j, frameptr, j);
+                } else frameptr = burstframe[burstsave - burstsram] + i*j;
+
+                if (hibpp == 1) k = FSfwrite(frameptr, j, 1, fptr);
+                else {
+                    conv16_24line(frameptr, avibuf, xpixels);
+                    k = FSfwrite(avibuf, xpixels * 3, 1, fptr);
+                }
+            }
             FSfclose(fptr);
-            if (i == 0) {
-                printf("Err writing image" bot "OK");
-                camstate = s_camwait;
+            if (k == 0) {
+                printf(bot "Err writing image" del del);
+                camstate = s_camrestart;
+                break;
+            }
+            burstsave++;
+            break;
+
+        case s_hirestart: // full-resolution still. Lines are written to the BMP as they arrive through a wrapping FIFO in cambuffer.
+            // If the card can't keep up the capture gets lapped, so we restart from the first lost line on the next frame,
+            // so the image gets built up from bands over several frames
+            printf(bot whi);
+            camstate = s_camrestart; // default next state
+            if (!cardmounted) {
+                printf(inv"No Card         " inv del);
+                break;
+            }
+
+            cam_grabdisable();
+
+            i = FSchdir("\\CAMERA");
+            if (i) {
+                FSmkdir("CAMERA");
+                FSchdir("CAMERA");
+            }
+
+            i = 0;
+            do { // find first unused filename
+                docamname(camfile++, ct_bmp);
+                printf(bot "%-21s", camname);
+                fptr = FSfopen(camname, FS_READ);
+                i = (fptr != NULL);
+                if (i) FSfclose(fptr);
+            } while (i);
+
+            fptr = FSfopen(camname, FS_WRITE);
+            FSchdir("\\");
+            if (fptr == NULL) {
+                printf(bot "Error FileOpen  " del del);
                 break;
             }
 
+            cam_cammode = cammode; // to go back to afterwards
+            if (vidmode == vm_sxga) cam_enable(cammode_sxga_mono);
+            else cam_enable((camflags & camopt_mono) ? cammode_vga_mono : cammode_vga_rgb);
+
+            hibpp = (camflags & camopt_mono) ? 1 : 3;
+            hilinebytes = xpixels * ((camflags & camopt_mono) ? 1 : 2);
+            hififo = (cambufsize - 8 - hilinebytes) / hilinebytes / hirestep * hirestep; // whole queue entries, so batches don't straddle the wrap
+            hiline = hipasses = hitimer = 0;
 
+            if (writebmpheader(xpixels, ypixels, hibpp) == 0) {
+                FSfclose(fptr);
+                cam_enable(cam_cammode);
+                printf(bot "Err writing header" del del);
+                break;
+            }
+            printf(taby11 tabx0 yel "%-21s", camnames[cammode]);
+            camstate = s_hiressettle;
+            break;
+
+        case s_hiressettle: // let exposure catch up after mode change
+            hitimer += tick;
+            if (hitimer < 10) break;
+
+        case s_hirespass: // grab one frame from line hiline down, into FIFO
+            ystart = camconfig[cammode].ystart + hiline*ydiv;
+            ypixels = camconfig[cammode].ypixels - hiline;
+            cam_linequeue(hirestep);
+            cam_grabenable(camen_grab, 7, 7 + hififo * hilinebytes);
+            hipasses++;
+            hitimer = 0;
+            printf(bot whi "Line %4d pass %d", hiline, hipasses);
+            camstate = s_hiresrun;
+            break;
+
+        case s_hiresrun:
+            frameptr = cam_getline(&i);
+            if (frameptr == 0) {
+                hitimer += tick;
+                if ((hitimer > 100) || (butpress & powerbut)) { // 2 seconds with no lines - probably lines too long for sensor
+                    cam_grabdisable();
+                    FSfclose(fptr);
+                    cam_enable(cam_cammode);
+                    printf(bot "Capture failed   " del del);
+                    camstate = s_camrestart;
+                }
+                break;
+            }
+            hitimer = 0;
+            j = ypixels - i; // lines in this batch
+            if (j > hirestep) j = hirestep;
+
+            if (hibpp == 1) k = FSfwrite(frameptr, hilinebytes*j, 1, fptr);
+            else for (k = 1; j && k; j--, frameptr += hilinebytes) { // RGB565 to 888 one line at a time
+                    conv16_24line(frameptr, avibuf, xpixels);
+                    k = FSfwrite(avibuf, xpixels * 3, 1, fptr);
+                }
+            if (k == 0) {
+                cam_grabdisable();
+                FSfclose(fptr);
+                cam_enable(cam_cammode);
+                printf(bot "Err writing image" del del);
+                camstate = s_camrestart;
+                break;
+            }
+
+            if (cam_lineqdrops || (linecnt >= i + hififo)) { // lapped by capture while writing, so this batch may be corrupt
+                cam_grabdisable();
+                hiline += i;
+                FSfseek(fptr, 54 + ((hibpp == 1) ? 1024 : 0) + hiline * xpixels*hibpp, SEEK_SET); // redo from this batch next frame
+                camstate = s_hirespass;
+                break;
+            }
+
+            if (i + hirestep < ypixels) break; // more to come
+
+            cam_grabdisable();
+            FSfclose(fptr);
+            cam_enable(cam_cammode);
+            printf(bot "%-12s %d passes" del del, camname, hipasses);
+            camstate = s_camrestart;
             break;
 
         case s_camwait:
@@ -293,10 +293,15 @@ unsigned char* readcode(unsigned int bufoffset, unsigned int xpixels) {
 
 char* codescan(unsigned int action) {
     static unsigned int state, hires, explock,scanlines;
-    unsigned int i, x, y, min, max, c, a, s, t, d, w, l, bits, base;
+    unsigned int i, x, y, min, max, c, a, s, t, d, w, l, bits, base, line;
     char* thecode;
+    unsigned char* lineptr;
 #define height 32 // 1280 bytes/line so can only do limited height
 #define ypos 16
+#define linestep 4 // lines per line queue entry
+#define maxscanlines 4
+    static unsigned char results[maxscanlines][maxcodelen + 1], resdir[maxscanlines]; // decoded codes, held until frame displayed
+    static unsigned short resstart[maxscanlines], reslen[maxscanlines];
 
     switch (action) {
         case act_name: return ("CODESCAN");
@@ -320,7 +325,7 @@ char* codescan(unsigned int action) {
 
     if (action != act_poll) return (0);
 
-    if (!tick) return (0);
+    if (!tick) if (state != s_run) return (0); // run state polls every time to pick up lines as they arrive
 
 
     switch (state) {
@@ -345,6 +350,7 @@ char* codescan(unsigned int action) {
                 cam_setreg(0x12, 0x40); // VGA  mode
                 xpixels = 640;
             }
+            cam_linequeue(linestep);
             cam_grabenable(camen_grab, 7, 0);
             printf(cls);
         case s_restart:
@@ -378,7 +384,7 @@ char* codescan(unsigned int action) {
                 state = s_restart;
             }
             if (butpress & but3) {
-                if(++scanlines==5) scanlines=1;
+                if(++scanlines==maxscanlines+1) scanlines=1;
 
             }
 
@@ -387,34 +393,46 @@ char* codescan(unsigned int action) {
                 else led1_off;
 
 
-            if (!cam_newframe) break;
+            d = cam_newframe; // sample before draining queue, as ISR queues last lines before setting newframe
 
+            while ((lineptr = cam_getline(&line)) != 0) // decode scan lines as soon as DMA lands them, overlapping with rest of frame
+                for (i = 1; i != scanlines + 1; i++) {
+                    t = ((scanlines + 1) - i) * height / (scanlines + 1); // round to line
+                    if ((t < line) || (t >= line + linestep)) continue; // not in this batch
+                    y = (lineptr - cambuffer) + (t - line)*(hires ? 1280 : 640); // where in image to sample
+                    dispuart = debugcode;
 
-            monopalette(0, 255);
-            //downscale 640 or 1280 to screen width
-            dispimage(0, ypos, 128, height, img_mono | img_revscan | img_vdouble | (hires ? img_skip9 : img_skip4), cambuffer + 8);
+                    thecode = readcode(y, hires ? 1280 : 640);
 
-            for(i=1;i!=scanlines+1;i++)  plotblock(4,ypos+height*2*i/(scanlines+1),120,1,c_red);
-    
-            for(i=1;i!=scanlines+1;i++) {
-            t=((scanlines+1)-i)*height/(scanlines+1);  // round to line 
-            
-           // y = height * (hires ? 1280 : 640) *t + 8; // where in image to sample
-            y=t*(hires ? 1280 : 640)+8;
-            dispuart = debugcode;
+#if debugcode !=0
+                    printf("\n");
+                    dispuart = 0;
+#endif
+                    results[i - 1][0] = 0;
+                    if (thecode) {
+                        for (x = 0; x != maxcodelen + 1; x++) results[i - 1][x] = thecode[x];
+                        resstart[i - 1] = barstart;
+                        reslen[i - 1] = barlen;
+                        resdir[i - 1] = bardir;
+                    }
+                }// for lines
 
-            thecode = readcode(y, hires ? 1280 : 640);
+            if (!d) break;
 
-#if debugcode !=0     
-            printf("\n");
-            dispuart = 0;
-#endif
 
-            if (thecode == 0) printf(tabx0 whi "%c                ",0xA7+i);
+            monopalette(0, 255); // after decoding as palette shares memory with lenbuf
+            //downscale 640 or 1280 to screen width
+            dispscaled(0, ypos, 128, height * 2, img_mono | img_revscan | img_smooth, cambuffer + 8, hires ? 1280 : 640, height, hires ? 1280 : 640);
+
+            for(i=1;i!=scanlines+1;i++)  plotblock(4,ypos+height*2*i/(scanlines+1),120,1,c_red);
+
+            for(i=1;i!=scanlines+1;i++) {
+            if (results[i - 1][0] == 0) printf(tabx0 whi "%c                ",0xA7+i);
             else {
-                printf(tabx0  "%c%10s",0xA7+i, thecode);
-                plotblock(barstart / (hires ? 10 : 5), ypos+height*2*i/(scanlines+1), barlen / (hires ? 10 : 5), 2, bardir ? c_yel : c_grn);
+                printf(tabx0  "%c%10s",0xA7+i, results[i - 1]);
+                plotblock(resstart[i - 1] / (hires ? 10 : 5), ypos+height*2*i/(scanlines+1), reslen[i - 1] / (hires ? 10 : 5), 2, resdir[i - 1] ? c_yel : c_grn);
             }
+            results[i - 1][0] = 0;
             }// for lines
 
 #if debugcode !=0     
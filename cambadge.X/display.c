@@ -1,11 +1,109 @@
 #include "cambadge.h"
 #include "globals.h"
 #include "font6x8.inc"
+#include "font12x16.inc"
+#include "fontnum24x32.inc"
 #include "monorgb.h" // mono8->rgb565 lookup
+#include <sys/kmem.h> // for KVA_TO_PA, display DMA
 
 // oled & display formatting stuff
 
+// Images go to the OLED by DMA channel 2, paced by the SPI1 TX buffer-not-full event, so the CPU is free while
+// the display is fed. RGB565 is sent straight from the image, as one block if the lines are in order, else a line per block.
+// Other formats are converted a line at a time into one of two line buffers while the other one is being sent.
+// oledint ( DMA block done) starts the next line.
+
+// What's on the display is tracked as a signature of each 8x8 tile - a real RGB565 shadow would need 32K.
+// dispimage with img_diff only sends runs of tiles whose signature has changed. Anything else written invalidates the tiles it covers
+
+// dispscroll moves the controller's display start line, so the whole screen scrolls for the cost of two command bytes.
+// Screen row y is then at RAM row y + oled_scroll (mod 128), and anything straddling the end of RAM goes as two windows.
+
+// printf text is collected into runs of glyphs on one line in the same colours, and each run goes as one window,
+// rendered a glyph row at a time into the line buffers. A run ends at any control code, or at the end of each printf write.
+// Glyph rows are expanded through a 16 entry table of 4-pixel fg/bg patterns, built when a run starts, so there's no per-pixel test.
+// The current font applies to a whole run, and sets the line spacing. Tabs stay on the 6x8 grid.
+
+// In console mode, 6x8 text on the charwidth x vspace grid is also kept in a ring of con_lines lines of character cells,
+// so dispscrollback can show earlier output. A shadow of the cells on screen is kept from every text run sent, and
+// forgotten wherever anything else is drawn, so a redraw only sends cells that differ. Scrolling the view uses dispscroll,
+// so a step of one line only has to draw the line that comes into view.
+
+// The game canvas is an 8bpp background layer and a composed frame in RAM, with a few sprites drawn over the background.
+// Drawing marks the screen tiles it touches, and canvas_flush rebuilds just those tiles of the frame and sends them
+// as runs, the same as img_diff but without scanning the image to find out what changed.
+
+#define oled_tile 8 // tile size, pixels
+#define oled_tilesx (dispwidth / oled_tile)
+#define oled_tilesy (dispheight / oled_tile)
+
+static unsigned short __attribute__((aligned(4))) oled_linebuf[2][dispwidth]; // aligned for word stores of pixel pairs
+static unsigned int oled_tilesig[oled_tilesy][oled_tilesx]; // 0 = unknown. 32 bit, as 16 bit ones collide often enough to leave a stale tile
+static unsigned char* oled_img; // image, or colour value for solid blocks
+static unsigned char* oled_next; // next line, ready to send
+static unsigned int oled_xsize, oled_ysize, oled_format, oled_line, oled_nlines, oled_linebytes, oled_direct;
+static unsigned int oled_xoff, oled_w; // part of each image line being sent
+static unsigned int oled_t0, oled_cpu; // core timer at transfer start, CPU ticks used so far
+static unsigned int oled_scroll; // rows the screen has been scrolled up by
+static void (*oled_conv)(unsigned short*, const unsigned char*, unsigned int, unsigned int); // line converter for this image
+static unsigned int oled_step; // image bytes per output pixel
+static void (*oled_scaleconv)(unsigned short*, const unsigned char*, const unsigned char*, unsigned int, unsigned int); // 0 if not scaling
+static unsigned int oled_srcw, oled_srch, oled_stride, oled_xstep, oled_ystep; // dispscaled source, steps are 16.16 fixed point
+
+#define oled_fmt_text 0x8000 // internal format, oled_text glyphs
+#define oled_textmax (dispwidth / charwidth) // longest run that fits the line buffer
+#define oled_blank 0xff // oled_text index for characters not in the font
+static unsigned char oled_text[oled_textmax]; // glyphs of current run, as font index. In use until oled_busy clears
+static unsigned int oled_textlen, oled_textx, oled_texty;
+static unsigned short oled_textfg, oled_textbg;
+static unsigned int oled_textlut[16][2]; // 4 pixels for each nibble of glyph row, in oled_textfg/bg. Pairs as they go in the line buffer
+static unsigned int oled_lutfg = 0x10000, oled_lutbg; // colours oled_textlut was built for, none yet
+static const font_t* oled_textfont; // font of current run
+
+const font_t font6x8 = {charwidth, charheight, startchar, nchars_6x8, (const unsigned char*) FONT6x8};
+const font_t font12x16 = {12, 16, startchar, nchars_6x8, FONT12x16};
+const font_t fontnum24x32 = {24, 32, '+', ':' - '+' + 1, FONTNUM24x32};
+static const font_t* const oled_fonts[] = {&font6x8, &font12x16, &fontnum24x32}; // for control codes 0x10..
+static const font_t* oled_font = &font6x8;
+
+#define con_cols (dispwidth / charwidth)
+#define con_rows ((dispheight + vspace - charheight - 1) / vspace + 1) // text rows on screen, last one with no room for its gap
+#if con_lines
+#if con_lines <= con_rows
+#error con_lines must be more than a screenful
+#endif
+#define con_unknown 0 // con_shown value for cell not known to be showing a glyph
+static unsigned char con_text[con_lines][con_cols], con_attr[con_lines][con_cols]; // line n at n % con_lines. attr is fg | bg << 4 as primarycol index
+static unsigned char con_shown[con_rows][con_cols], con_shownattr[con_rows][con_cols]; // what each screen cell shows
+static unsigned int con_top; // line number at screen row 0 of the live view
+static unsigned int con_back; // lines the view is scrolled back by
+static unsigned int con_cleared; // lines before this have been blanked in the ring
+static unsigned char con_drawing; // redrawing from the ring, so don't record
+static unsigned char con_runattr; // attr for glyphs of current text run
+
+static void con_clearto(unsigned int n) { // blank lines up to n in the ring as they first come into use
+    unsigned int c;
+    for (; con_cleared < n; con_cleared++)
+        for (c = 0; c != con_cols; c++) {
+            con_text[con_cleared % con_lines][c] = ' ';
+            con_attr[con_cleared % con_lines][c] = 7; // white on black
+        }
+}
+#endif
+
+typedef struct {
+    const unsigned char* img; // 0 = not shown
+    int x, y; // canvas co-ordinates, can be partly off it
+    unsigned int w, h;
+} canvas_spr_t;
+static unsigned char *cv_bg, *cv_fb; // background layer, composed frame
+static unsigned int cv_x, cv_y, cv_w, cv_h; // canvas area on screen
+static unsigned short cv_dirty[oled_tilesy]; // screen tiles to rebuild & send at next flush, bit per tile column
+static canvas_spr_t cv_spr[canvas_maxsprites];
+
 void oledcmd(unsigned int d) { // send byte to display, bit 8 set for command, clear for data
+    oled_wait();
+    oled_spibytes++;
     while (SPI1STATbits.SPIBUSY); // in case previous buffered data still being sent
     if (d & 0x100) oled_cd_lo;
     else oled_cd_hi;
@@ -53,6 +151,7 @@ void oled_init(void) { //initialise display after powerup. see SSD1351 chip and
     delayus(oled_reset_time);
     
     for (i = 0; i != sizeof (oledinitdata) / 2; oledcmd(oledinitdata[i++]));
+    oled_scroll = 0; // start line set to 0 by init
      while (SPI1STATbits.SPIBUSY);    oled_cs_hi;
     plotblock(0, 0, dispwidth, dispheight, 0); // clear display memory
     dispx = dispy = 0;
@@ -63,6 +162,7 @@ void oled_init(void) { //initialise display after powerup. see SSD1351 chip and
 
 void monopalette(unsigned int min, unsigned int max) {
     unsigned int i, d;
+    oled_wait(); // palette may be in use by a display transfer
     for (i = 0; i != 256; i++) {
         d = (i - min)*255 / (max - min);
         if (i <= min) d = 0;
@@ -74,59 +174,8 @@ void monopalette(unsigned int min, unsigned int max) {
 
 
 
-void plotblock(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int col)
-{
-    unsigned int i;
-
-    
- if ((xstart + xsize > dispwidth) || (ystart + ysize > dispheight) || (xsize == 0) || (ysize == 0)) return; 
-    
-        oled_cs_lo;
-        oled_cd_lo;
-        SPI1BUF=0x75; while (SPI1STATbits.SPIBUSY); oled_cd_hi;
-        SPI1BUF=xstart; 
-        SPI1BUF=xstart + xsize - 1; 
-        while (SPI1STATbits.SPIBUSY);
-    
-
-#if oled_upscan==1
-       oled_cd_lo;      
-        SPI1BUF=0x15; 
-        i=((dispheight - ystart - 1) - ysize + 1); 
-        while (SPI1STATbits.SPIBUSY); 
-        oled_cd_hi;
-        SPI1BUF=i; 
-        SPI1BUF=dispheight - ystart - 1;
-        while (SPI1STATbits.SPIBUSY); 
-
-#else
-        
-        oled_cd_lo;      
-        SPI1BUF=0x15; 
-       while (SPI1STATbits.SPIBUSY); 
-        oled_cd_hi;
-        SPI1BUF=ystart; 
-        SPI1BUF=ystart + ysize - 1;
-        while (SPI1STATbits.SPIBUSY); 
-
-#endif  
-    
- 
-oled_cd_lo;      
-        SPI1BUF=0x15c;   //send data
-        i = xsize*ysize;
-       while (SPI1STATbits.SPIBUSY); 
-        oled_cd_hi;
-     SPI1CONbits.MODE16 = 1; // 16 bit for ease of accesss - no speed improvement
-
-    do {
-        while (SPI1STATbits.SPITBF);
-        SPI1BUF = col;
-        
-    } while(--i);
-      while (SPI1STATbits.SPIBUSY); // wait until last byte sent before releasing CS. if we were DMAing, this would be done in DMA complete int
-    SPI1CONbits.MODE16 = 0; // back to 8 bit mode
-    oled_cs_hi;
+void plotblock(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int col) {
+    dispimage(xstart, ystart, xsize, ysize, img_nowait, (unsigned char*) col); // nothing to keep, so no need to wait
 }
 
 
@@ -149,97 +198,700 @@ void mplotblock(unsigned int x, unsigned int y, unsigned int width, unsigned int
 
 }
 
-void dispimage(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format, unsigned char* imgaddr) { // display image or solid colour in various formats. Note assumes format = bytes per pixel
-    // for solid, image pointer is solid colour value, called via plotblock macro
-    unsigned int i, d, e, y, x, r, g, b, bpp, skip,vdup,vcount;
-    unsigned char *imgaddr2;
-    bpp = format & 3;
-    skip = (format & 0xf0) >> 4;
-    vdup=(format & img_vdouble)?2:1;
-   
+// line converters, one per format so there's no per-pixel format decision. Picked by dispimage from oled_convtab.
+// n pixels from s to d, step is image bytes per pixel including any skipped ones.
+// The unskipped ones read the image a word at a time once aligned, as byte loads are as slow as word loads
+
+#define oled_rgb(r, g, b) (((r) << 8 & 0xf800) | ((g) << 3 & 0x7c0) | ((b) >> 3))
+
+static void oled_convsolid(unsigned short* d, const unsigned char* s, unsigned int n, unsigned int step) {
+    unsigned int c = (unsigned int) oled_img;
+    while (n--) *d++ = c;
+}
+
+static void oled_convmono(unsigned short* d, const unsigned char* s, unsigned int n, unsigned int step) {
+    unsigned int w;
+    for (; n && ((unsigned int) s & 3); n--) *d++ = palette[*s++];
+    for (; n >= 4; n -= 4, d += 4) {
+        w = *(const unsigned int*) s;
+        s += 4;
+        d[0] = palette[w & 0xff];
+        d[1] = palette[w >> 8 & 0xff];
+        d[2] = palette[w >> 16 & 0xff];
+        d[3] = palette[w >> 24];
+    }
+    while (n--) *d++ = palette[*s++];
+}
+
+static void oled_convmonoskip(unsigned short* d, const unsigned char* s, unsigned int n, unsigned int step) {
+    for (; n; n--, s += step) *d++ = palette[*s];
+}
+
+static void oled_conv565(unsigned short* d, const unsigned char* s, unsigned int n, unsigned int step) { // odd-aligned or skipped, else sent direct
+    for (; n; n--, s += step) *d++ = s[0] | s[1] << 8;
+}
+
+static void oled_conv888(unsigned short* d, const unsigned char* s, unsigned int n, unsigned int step) {
+    unsigned int w0, w1, w2;
+    for (; n && ((unsigned int) s & 3); n--, s += 3) *d++ = oled_rgb(s[2], s[1], s[0]);
+    for (; n >= 4; n -= 4, s += 12, d += 4) { // 4 pixels in 3 words
+        w0 = ((const unsigned int*) s)[0];
+        w1 = ((const unsigned int*) s)[1];
+        w2 = ((const unsigned int*) s)[2];
+        d[0] = oled_rgb(w0 >> 16 & 0xff, w0 >> 8 & 0xff, w0 & 0xff);
+        d[1] = oled_rgb(w1 >> 8 & 0xff, w1 & 0xff, w0 >> 24);
+        d[2] = oled_rgb(w2 & 0xff, w1 >> 24, w1 >> 16 & 0xff);
+        d[3] = oled_rgb(w2 >> 24, w2 >> 16 & 0xff, w2 >> 8 & 0xff);
+    }
+    for (; n; n--, s += 3) *d++ = oled_rgb(s[2], s[1], s[0]);
+}
+
+static void oled_conv888skip(unsigned short* d, const unsigned char* s, unsigned int n, unsigned int step) {
+    for (; n; n--, s += step) *d++ = oled_rgb(s[2], s[1], s[0]);
+}
+
+static void (* const oled_convtab[4][2])(unsigned short*, const unsigned char*, unsigned int, unsigned int) = {// [bpp][skipping]
+    {oled_convsolid, oled_convsolid},
+    {oled_convmono, oled_convmonoskip},
+    {oled_conv565, oled_conv565},
+    {oled_conv888, oled_conv888skip}
+};
+
+// scaling line converters, output pixels x..x+n-1 from source line s. Smooth ones average with the next pixel and with s2, the next line.
+// 565 is averaged in two masked parts so each channel gets room to carry into, see oled_avg565
+
+#define oled_srcx(x) (((x) * oled_xstep + oled_xstep / 2) >> 16)
+#define oled_srcx2(x) (((x) * oled_xstep + oled_xstep / 2 < 0x8000) ? 0 : ((x) * oled_xstep + oled_xstep / 2 - 0x8000) >> 16)
+#define oled_avg565(a, b, c, e) (((((a) & 0xf81f) + ((b) & 0xf81f) + ((c) & 0xf81f) + ((e) & 0xf81f)) >> 2 & 0xf81f) \
+        | ((((a) & 0x7e0) + ((b) & 0x7e0) + ((c) & 0x7e0) + ((e) & 0x7e0)) >> 2 & 0x7e0))
+
+static void oled_scalemono(unsigned short* d, const unsigned char* s, const unsigned char* s2, unsigned int x, unsigned int n) {
+    for (; n; n--, x++) *d++ = palette[s[oled_srcx(x)]];
+}
+
+static void oled_scale565(unsigned short* d, const unsigned char* s, const unsigned char* s2, unsigned int x, unsigned int n) {
+    const unsigned char* p;
+    for (; n; n--, x++) {
+        p = s + oled_srcx(x) * 2;
+        *d++ = p[0] | p[1] << 8;
+    }
+}
+
+static void oled_scale888(unsigned short* d, const unsigned char* s, const unsigned char* s2, unsigned int x, unsigned int n) {
+    const unsigned char* p;
+    for (; n; n--, x++) {
+        p = s + oled_srcx(x) * 3;
+        *d++ = oled_rgb(p[2], p[1], p[0]);
+    }
+}
+
+static void oled_smoothmono(unsigned short* d, const unsigned char* s, const unsigned char* s2, unsigned int x, unsigned int n) {
+    unsigned int a, b;
+    for (; n; n--, x++) {
+        a = oled_srcx2(x);
+        if (a >= oled_srcw) a = oled_srcw - 1;
+        b = (a + 1 < oled_srcw) ? a + 1 : a;
+        *d++ = oled_avg565(palette[s[a]], palette[s[b]], palette[s2[a]], palette[s2[b]]); // palette needn't be in order
+    }
+}
+
+static void oled_smooth565(unsigned short* d, const unsigned char* s, const unsigned char* s2, unsigned int x, unsigned int n) {
+    unsigned int a, b;
+    for (; n; n--, x++) {
+        a = oled_srcx2(x);
+        if (a >= oled_srcw) a = oled_srcw - 1;
+        b = (a + 1 < oled_srcw) ? (a + 1) * 2 : a * 2;
+        a *= 2;
+        *d++ = oled_avg565(s[a] | s[a + 1] << 8, s[b] | s[b + 1] << 8, s2[a] | s2[a + 1] << 8, s2[b] | s2[b + 1] << 8);
+    }
+}
+
+static void oled_smooth888(unsigned short* d, const unsigned char* s, const unsigned char* s2, unsigned int x, unsigned int n) {
+    unsigned int a, b;
+    for (; n; n--, x++) {
+        a = oled_srcx2(x);
+        if (a >= oled_srcw) a = oled_srcw - 1;
+        b = (a + 1 < oled_srcw) ? (a + 1) * 3 : a * 3;
+        a *= 3;
+        *d++ = oled_rgb((s[a + 2] + s[b + 2] + s2[a + 2] + s2[b + 2]) >> 2, (s[a + 1] + s[b + 1] + s2[a + 1] + s2[b + 1]) >> 2,
+                (s[a] + s[b] + s2[a] + s2[b]) >> 2);
+    }
+}
+
+static void (* const oled_scaletab[4][2])(unsigned short*, const unsigned char*, const unsigned char*, unsigned int, unsigned int) = {// [bpp][smooth]
+    {0, 0}, // solid isn't scaled
+    {oled_scalemono, oled_smoothmono},
+    {oled_scale565, oled_smooth565},
+    {oled_scale888, oled_smooth888}
+};
+
+static unsigned int oled_glyphrow(unsigned int g, unsigned int r) { // row r of glyph g in oled_textfont, left aligned in a word
+    const font_t* f = oled_textfont;
+    const unsigned char* p;
+    unsigned int b;
+    if (g == oled_blank) return (0);
+    p = f->bits + (g * f->height + r) * ((f->width + 7) >> 3);
+    b = p[0] << 24;
+    if (f->width > 8) b |= p[1] << 16;
+    if (f->width > 16) b |= p[2] << 8;
+    if (f->width > 24) b |= p[3];
+    return (b);
+}
+
+static unsigned char* oled_prepline(unsigned int n) { // get line n of output ready to send, return its address
+    unsigned int d, x, y, r, b;
+    unsigned char* imgaddr2;
+    unsigned short* dest;
+    unsigned int *wdest, *l;
+
+    if (oled_format & oled_fmt_text) { // glyph row n of the run
 #if oled_upscan==1
-    format ^= img_revscan;
+        r = oled_textfont->height - 1 - n;
+#else
+        r = n;
 #endif
-    if ((xstart + xsize > dispwidth) || (ystart + ysize > dispheight) || (xsize == 0) || (ysize == 0)) return;
-    
+        wdest = (unsigned int*) oled_linebuf[n & 1]; // glyph widths are even, so pixel pairs stay word aligned
+        for (x = 0; x != oled_w / oled_textfont->width; x++) {
+            b = oled_glyphrow(oled_text[x], r);
+            for (d = oled_textfont->width; d >= 4; d -= 4, b <<= 4) {
+                l = oled_textlut[b >> 28];
+                *wdest++ = l[0];
+                *wdest++ = l[1];
+            }
+            if (d) *wdest++ = oled_textlut[b >> 28][0];
+        }
+        return ((unsigned char*) oled_linebuf[n & 1]);
+    }
+
+    if (oled_scaleconv) { // sample at the middle of each output pixel's footprint in the source
+        d = n * oled_ystep + oled_ystep / 2;
+        y = d >> 16;
+        if (oled_format & img_smooth) y = (d < 0x8000) ? 0 : (d - 0x8000) >> 16; // pair of lines either side
+        if (y >= oled_srch) y = oled_srch - 1;
+        r = (y + 1 < oled_srch) ? y + 1 : y;
+        if (oled_format & img_revscan) {
+            y = oled_srch - 1 - y;
+            r = oled_srch - 1 - r;
+        }
+        oled_scaleconv(oled_linebuf[n & 1], oled_img + y * oled_stride, oled_img + r * oled_stride, oled_xoff, oled_w);
+        return ((unsigned char*) oled_linebuf[n & 1]);
+    }
+
+    y = (oled_format & img_vdouble) ? n / 2 : n;
+    if (oled_format & img_revscan) y = oled_ysize - y - 1;
+    imgaddr2 = oled_img + (y * oled_xsize + oled_xoff) * oled_step;
+    if (oled_direct) return (imgaddr2);
+
+    oled_conv(oled_linebuf[n & 1], imgaddr2, oled_w, oled_step);
+    return ((unsigned char*) oled_linebuf[n & 1]);
+}
+
+static void oled_sendline(unsigned char* p) { // DMA one line ( or whole image if direct & in order) to SPI1
+    DCH2CON = 0;
+    DCH2SSA = KVA_TO_PA(p);
+    DCH2SSIZ = oled_linebytes;
+    DCH2INTCLR = 0xff;
+    DCH2CONSET = 0b0000000010000000; // enable, priority 0
+    // SPI TX event only comes as a word leaves the FIFO, so if it's already drained we need to push the first word.
+    // FIFO empty means there's room for it even if an event sneaks in as well
+    if (SPI1STATbits.SPITBE) DCH2ECONSET = 1 << 7;
+}
+
+void oled_dmanext(void) { // line sent, start the next one and convert the one after while it goes
+    unsigned int t = _CP0_GET_COUNT();
+    IFS1CLR = _IFS1_DMA2IF_MASK;
+    DCH2INTCLR = 0xff;
+    if (oled_line == oled_nlines) { // all done
+        IEC1CLR = _IEC1_DMA2IE_MASK;
+        DCH2CON = 0;
+        while (SPI1STATbits.SPIBUSY); // wait until last word sent before releasing CS - up to a FIFO's worth
+        SPI1CONbits.MODE16 = 0; // back to 8 bit mode
+        oled_cs_hi;
+        oled_cputime = oled_cpu + _CP0_GET_COUNT() - t;
+        oled_xfertime = _CP0_GET_COUNT() - oled_t0;
+        oled_busy = 0;
+        return;
+    }
+    oled_sendline(oled_next);
+    if (++oled_line != oled_nlines) oled_next = oled_prepline(oled_line);
+    oled_cpu += _CP0_GET_COUNT() - t;
+}
+
+void oled_wait(void) {
+    while (oled_busy) // before setupints or with ints off, the int won't happen so do it here
+        if ((((_CP0_GET_STATUS() & 1) == 0) || (IPC10bits.DMA2IP == 0)) && (IFS1 & _IFS1_DMA2IF_MASK)) oled_dmanext();
+}
+
+static void oled_window(unsigned int x, unsigned int y, unsigned int w, unsigned int h) { // set write window, screen co-ordinates. Mustn't wrap in RAM
+    y = (y + oled_scroll) & (dispheight - 1);
     oledcmd(0x175);
-    oledcmd(xstart);
-    oledcmd(xstart + xsize - 1); // column address
+    oledcmd(x);
+    oledcmd(x + w - 1); // column address
 #if oled_upscan==1
     oledcmd(0x115);
-    oledcmd((dispheight - ystart - 1) - ysize*vdup + 1);
-    oledcmd(dispheight - ystart - 1); // row address
+    oledcmd(dispheight - y - h);
+    oledcmd(dispheight - y - 1); // row address
 #else   
     oledcmd(0x115);
-    oledcmd(ystart);
-    oledcmd(ystart + ysize*vdup - 1); // row address
+    oledcmd(y);
+    oledcmd(y + h - 1); // row address
 #endif 
-
     oledcmd(0x15c); //send data
+}
 
-    i = xsize*ysize;
-    if (((unsigned int) imgaddr + i * bpp * (skip + 1)) >= ((unsigned int) &cambuffer + cambufsize)) return;
+static void oled_forgettiles(unsigned int x, unsigned int y, unsigned int w, unsigned int h) {
+    unsigned int tx, ty;
+    for (ty = y / oled_tile; (ty <= (y + h - 1) / oled_tile) && (ty != oled_tilesy); ty++) // text can hang off the edges
+        for (tx = x / oled_tile; (tx <= (x + w - 1) / oled_tile) && (tx != oled_tilesx); tx++) oled_tilesig[ty][tx] = 0;
+}
+
+static void con_forget(unsigned int x, unsigned int y, unsigned int w, unsigned int h) { // screen area drawn over, so cells there are unknown
+#if con_lines
+    unsigned int r, c;
+    r = y / vspace;
+    if (y % vspace >= charheight) r++; // starts in the gap below a row
+    for (; (r <= (y + h - 1) / vspace) && (r < con_rows); r++)
+        for (c = x / charwidth; (c <= (x + w - 1) / charwidth) && (c < con_cols); c++) con_shown[r][c] = con_unknown;
+#endif
+}
+
+void oled_invalidate(unsigned int x, unsigned int y, unsigned int w, unsigned int h) { // forget signatures of tiles in area
+    oled_forgettiles(x, y, w, h);
+    con_forget(x, y, w, h);
+}
+
+static void oled_start(unsigned int t, unsigned int xoff, unsigned int w, unsigned int n0, unsigned int n1) { // DMA output lines n0..n1-1, pixels xoff..xoff+w-1 of each
+    oled_busy = 1;
+    oled_xoff = xoff;
+    oled_w = w;
+    oled_line = n0;
+    oled_nlines = n1;
+    oled_linebytes = w * 2;
+    oled_spibytes += w * 2 * (n1 - n0);
+    if (oled_direct && (w == oled_xsize) && !(oled_format & (img_vdouble | img_revscan))) { // lines in order, so all in one go
+        oled_nlines = n0 + 1;
+        oled_linebytes = w * 2 * (n1 - n0);
+    }
 
     oled_cd_hi;
     oled_cs_lo;
-    SPI1CONbits.MODE16 = 1; // 16 bit for ease of accesss - no speed improvement
+    SPI1CONbits.MODE16 = 1; // 16 bit, one DMA cell per pixel
 
     //contrary to what datasheet implies, it doesn't seem necessary to de-assert CS between bytes, 
-    // so we can use buffered mode to avoid gaps between bytes for higher throughput.
-
-    // Code doesn't need to be super-efficient as speed is limited by OLED max SPI clock rate. 
-    // as long as we can produce 1 pixel every 1.3uS avaraged over the 8 pixel FIFO size we're maxing out the SPI bus
-
-
-    for (y = 0; y != ysize; y++) {
-        
-        for(vcount=0;vcount!=vdup;vcount++) {
-            
-        if (format & img_revscan) imgaddr2 = imgaddr + (ysize - y - 1) * xsize * bpp *(skip + 1);
-        else imgaddr2 = imgaddr + y * xsize * bpp * (skip + 1);
-
-        for (x = 0; x != xsize; x++) {
-            switch (bpp) {
-                case 0: d = (unsigned int) imgaddr;
-                    break;
-
-                case 1: d = palette[*imgaddr2++];
-                    imgaddr2 += skip;
-                    break;
-                case 2:
-                    d = *imgaddr2++;
-                    d |= (*imgaddr2++) << 8;
-                    imgaddr2 += skip * 2;
-                    break;
-
-                case 3:
-                    b = *imgaddr2++;
-                    g = *imgaddr2++;
-                    r = *imgaddr2++;
-                    d = (r << 8 & 0xf800) | (g << 3 & 0x7C0) | (b >> 3);
-                    imgaddr2 += skip * 3;
-            } // switch bpp   
+    // so the DMA can keep the FIFO topped up with no gaps between lines
 
-            while (SPI1STATbits.SPITBF);
-            SPI1BUF = d;
-        } // for x
-        } // for vcount
-    }// for y 
+    DMACONSET = 1 << 15;
+    DCH2ECON = _SPI1_TX_IRQ << 8 | 1 << 4; // trigger on SPI1 TX buffer not full
+    DCH2DSA = KVA_TO_PA(&SPI1BUF);
+    DCH2DSIZ = 2;
+    DCH2CSIZ = 2;
+    DCH2INT = 1 << 19; // flag on block complete
+    IFS1CLR = _IFS1_DMA2IF_MASK;
+
+    oled_t0 = t;
+    oled_sendline(oled_prepline(n0));
+    if (++oled_line != oled_nlines) oled_next = oled_prepline(oled_line); // convert next line while first one goes
+    oled_cpu = _CP0_GET_COUNT() - t;
+    IEC1SET = _IEC1_DMA2IE_MASK; // only now, as int needs next line ready. If first line already done, int happens straight away
+}
+
+static void oled_area(unsigned int t, unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned int xoff, unsigned int ystart, unsigned int nlines) {
+    // send screen area x,y,w,h of image set up at ystart, nlines high. Clipped to the bottom of the screen, and split where it wraps in RAM
+    unsigned int k;
+    if (y >= dispheight) return;
+    con_forget(x, y, w, h);
+    if (y + h > dispheight) h = dispheight - y; // text can hang off the bottom
+    k = dispheight - ((y + oled_scroll) & (dispheight - 1)); // rows before end of RAM
+    if (h > k) {
+        oled_area(t, x, y, w, k, xoff, ystart, nlines);
+        oled_area(_CP0_GET_COUNT(), x, y + k, w, h - k, xoff, ystart, nlines);
+        return;
+    }
+    oled_window(x, y, w, h); // waits for any previous transfer
+#if oled_upscan==1
+    oled_start(t, xoff, w, nlines - (y + h - ystart), nlines - (y - ystart));
+#else
+    oled_start(t, xoff, w, y - ystart, y + h - ystart);
+#endif
+}
+
+static void oled_sendtiles(unsigned int t, unsigned int xstart, unsigned int ystart, unsigned int nlines, unsigned short* dirty) {
+    // send the dirty tiles of image set up at xstart,ystart, nlines high, clearing dirty[] as they go
+    unsigned int ty, ty2, m, a, b, x0, x1, y0, y1;
 
+    for (ty = ystart / oled_tile; ty <= (ystart + nlines - 1) / oled_tile; ty++)
+        while (dirty[ty]) { // send each run of dirty tiles, extended down while rows below have the same run dirty
+            for (a = 0; !(dirty[ty] & 1 << a); a++);
+            for (b = a; (b != oled_tilesx - 1) && (dirty[ty] & 1 << (b + 1)); b++);
+            m = (2 << b) - (1 << a);
+            dirty[ty] &= ~m;
+            for (ty2 = ty; (ty2 != (ystart + nlines - 1) / oled_tile) && ((dirty[ty2 + 1] & m) == m); ty2++) dirty[ty2 + 1] &= ~m;
 
-    while (SPI1STATbits.SPIBUSY); // wait until last byte sent before releasing CS. if we were DMAing, this would be done in DMA complete int
-    SPI1CONbits.MODE16 = 0; // back to 8 bit mode
+            x0 = (a * oled_tile > xstart) ? a * oled_tile : xstart;
+            x1 = (b * oled_tile + oled_tile < xstart + oled_xsize) ? b * oled_tile + oled_tile : xstart + oled_xsize;
+            y0 = (ty * oled_tile > ystart) ? ty * oled_tile : ystart;
+            y1 = (ty2 * oled_tile + oled_tile < ystart + nlines) ? ty2 * oled_tile + oled_tile : ystart + nlines;
+            oled_area(t, x0, y0, x1 - x0, y1 - y0, x0 - xstart, ystart, nlines);
+            t = _CP0_GET_COUNT();
+        }
+}
+
+static void oled_diff(unsigned int t, unsigned int xstart, unsigned int ystart, unsigned int nlines) { // send changed tiles of image set up by dispimage
+    unsigned int x, y, n, tx, ty, d, y0, y1;
+    unsigned int sig[oled_tilesx];
+    unsigned short dirty[oled_tilesy], *p;
+
+    oled_xoff = 0; // signatures over whole image width
+    oled_w = oled_xsize;
+    for (ty = ystart / oled_tile; ty <= (ystart + nlines - 1) / oled_tile; ty++) {
+        dirty[ty] = 0;
+        y0 = (ty * oled_tile > ystart) ? ty * oled_tile : ystart; // part of this tile row covered by image
+        y1 = (ty * oled_tile + oled_tile < ystart + nlines) ? ty * oled_tile + oled_tile : ystart + nlines;
+        for (tx = xstart / oled_tile; tx <= (xstart + oled_xsize - 1) / oled_tile; tx++)
+            sig[tx] = 0x811c9dc5 ^ (y0 - ty * oled_tile) ^ (y1 - y0) << 4 ^ xstart << 8; // seed with coverage so partial tiles only match the same partial tile
+        for (y = y0; y != y1; y++) {
+#if oled_upscan==1
+            n = nlines - 1 - (y - ystart);
+#else
+            n = y - ystart;
+#endif
+            p = (unsigned short*) oled_prepline(n);
+            for (x = 0; x != oled_xsize; x++) {
+                tx = (xstart + x) / oled_tile;
+                sig[tx] = (sig[tx] ^ *p++) * 0x01000193; // FNV-1a on pixels as they'd be sent
+            }
+        }
+        for (tx = xstart / oled_tile; tx <= (xstart + oled_xsize - 1) / oled_tile; tx++) {
+            d = sig[tx];
+            if (d == 0) d = 1;
+            if (oled_tilesig[ty][tx] != d) {
+                oled_tilesig[ty][tx] = d;
+                dirty[ty] |= 1 << tx;
+            }
+        }
+    }
+    oled_sendtiles(t, xstart, ystart, nlines, dirty);
+}
+
+static void oled_show(unsigned int t, unsigned int xstart, unsigned int ystart, unsigned int nlines) { // send image set up by dispimage/dispscaled
+    if (oled_format & img_diff) oled_diff(t, xstart, ystart, nlines);
+    else {
+        oled_invalidate(xstart, ystart, oled_xsize, nlines);
+        oled_area(t, xstart, ystart, oled_xsize, nlines, 0, ystart, nlines);
+    }
+    if (!(oled_format & img_nowait)) oled_wait();
+}
+
+void dispimage(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format, unsigned char* imgaddr) { // display image or solid colour in various formats. Note assumes format = bytes per pixel
+    // for solid, image pointer is solid colour value, called via plotblock
+    unsigned int i, bpp, skip, vdup, t;
+    t = _CP0_GET_COUNT();
+    bpp = format & 3;
+    skip = (format & 0xf0) >> 4;
+    vdup=(format & img_vdouble)?2:1;
+   
+#if oled_upscan==1
+    format ^= img_revscan;
+#endif
+    if ((xstart + xsize > dispwidth) || (ystart + ysize*vdup > dispheight) || (xsize == 0) || (ysize == 0)) return;
+    i = xsize*ysize;
+    if (((unsigned int) imgaddr + i * bpp * (skip + 1)) >= ((unsigned int) &cambuffer + cambufsize)) return;
+
+    oled_wait(); // engine state & line buffers in use until then
+    oled_img = imgaddr;
+    oled_xsize = xsize;
+    oled_ysize = ysize;
+    oled_format = format;
+    oled_direct = (bpp == 2) && (skip == 0) && (((unsigned int) imgaddr & 1) == 0); // RGB565 can go straight from the image
+    oled_conv = oled_convtab[bpp][skip != 0];
+    oled_step = bpp * (skip + 1);
+    oled_scaleconv = 0;
+    oled_show(t, xstart, ystart, ysize * vdup);
+}
+
+void dispframe(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, const frame_t* f, unsigned int opts) {
+    if ((xsize == f->width) && (ysize == f->height) && (f->stride == f->width * (f->format & 3)))
+        dispimage(xstart, ystart, xsize, ysize, f->format | opts, f->pixels); // packed 1:1, so can go direct
+    else dispscaled(xstart, ystart, xsize, ysize, f->format | opts, f->pixels, f->width, f->height, f->stride);
+}
+
+void dispscaled(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format, unsigned char* imgaddr,
+        unsigned int srcw, unsigned int srch, unsigned int stride) {
+    unsigned int bpp, t;
+    t = _CP0_GET_COUNT();
+    bpp = format & 3;
+#if oled_upscan==1
+    format ^= img_revscan;
+#endif
+    if ((xstart + xsize > dispwidth) || (ystart + ysize > dispheight) || (xsize == 0) || (ysize == 0) || (srcw == 0) || (srch == 0) || (bpp == 0)) return;
+
+    oled_wait();
+    oled_img = imgaddr;
+    oled_xsize = xsize;
+    oled_ysize = ysize;
+    oled_format = format & ~(img_vdouble | 0xf0);
+    oled_direct = 0;
+    oled_scaleconv = oled_scaletab[bpp][(format & img_smooth) ? 1 : 0];
+    oled_srcw = srcw;
+    oled_srch = srch;
+    oled_stride = stride;
+    oled_xstep = (srcw << 16) / xsize;
+    oled_ystep = (srch << 16) / ysize;
+    oled_show(t, xstart, ystart, ysize);
+}
+
+static void cv_mark(int x, int y, int w, int h) { // mark screen tiles covering canvas area dirty, clipped to the canvas
+    int x1 = x + w, y1 = y + h;
+    unsigned int ty, m;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 > (int) cv_w) x1 = cv_w;
+    if (y1 > (int) cv_h) y1 = cv_h;
+    if ((x >= x1) || (y >= y1)) return;
+    x += cv_x; // now screen co-ordinates, x1 & y1 inclusive
+    x1 += cv_x - 1;
+    y += cv_y;
+    y1 += cv_y - 1;
+    m = (2 << (x1 / oled_tile)) - (1 << (x / oled_tile));
+    for (ty = y / oled_tile; ty <= y1 / oled_tile; ty++) cv_dirty[ty] |= m;
+}
+
+static void cv_compose(int x0, int y0, int x1, int y1) { // rebuild canvas area x0..x1-1, y0..y1-1 of the frame: background, then sprites in order
+    int x, y, a, b, c, e, n;
+    const unsigned char* s;
+    unsigned char* d;
+    canvas_spr_t* sp;
+
+    for (y = y0; y != y1; y++) {
+        s = cv_bg + y * cv_w + x0;
+        d = cv_fb + y * cv_w + x0;
+        for (x = x0; x != x1; x++) *d++ = *s++;
+    }
+    for (n = 0; n != canvas_maxsprites; n++) {
+        sp = &cv_spr[n];
+        if (sp->img == 0) continue;
+        a = (sp->x > x0) ? sp->x : x0; // part of sprite inside the area
+        b = (sp->x + (int) sp->w < x1) ? sp->x + (int) sp->w : x1;
+        c = (sp->y > y0) ? sp->y : y0;
+        e = (sp->y + (int) sp->h < y1) ? sp->y + (int) sp->h : y1;
+        if ((a >= b) || (c >= e)) continue;
+        for (y = c; y != e; y++) {
+            s = sp->img + (y - sp->y) * sp->w + (a - sp->x);
+            d = cv_fb + y * cv_w + a;
+            for (x = a; x != b; x++, s++, d++) if (*s != canvas_clear) *d = *s;
+        }
+    }
+}
+
+void canvas_init(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned char* buf) {
+    unsigned int i;
+    if ((x + w > dispwidth) || (y + h > dispheight) || (w == 0) || (h == 0)) return;
+    oled_wait(); // buffer may be going out from a previous flush
+    cv_bg = buf;
+    cv_fb = buf + w * h;
+    cv_x = x;
+    cv_y = y;
+    cv_w = w;
+    cv_h = h;
+    for (i = 0; i != w * h; i++) cv_bg[i] = 0;
+    for (i = 0; i != canvas_maxsprites; i++) cv_spr[i].img = 0;
+    for (i = 0; i != oled_tilesy; i++) cv_dirty[i] = 0;
+    cv_mark(0, 0, w, h); // first flush sends the lot
+}
+
+void canvas_fill(int x, int y, int w, int h, unsigned int col) {
+    int x1 = x + w, y1 = y + h, i, j, c = 0;
+    unsigned char* d;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 > (int) cv_w) x1 = cv_w;
+    if (y1 > (int) cv_h) y1 = cv_h;
+    if ((x >= x1) || (y >= y1)) return;
+    for (j = y; j != y1; j++) {
+        d = cv_bg + j * cv_w + x;
+        for (i = x; i != x1; i++, d++) {
+            c |= *d ^ col;
+            *d = col;
+        }
+    }
+    if (c & 0xff) cv_mark(x, y, x1 - x, y1 - y); // only resend if it's changed
+}
+
+void canvas_sprite(unsigned int n, int x, int y, unsigned int w, unsigned int h, const unsigned char* img) {
+    canvas_spr_t* sp;
+    if (n >= canvas_maxsprites) return;
+    sp = &cv_spr[n];
+    if ((sp->img == img) && (sp->x == x) && (sp->y == y) && (sp->w == w) && (sp->h == h)) return; // not moved, nothing to send
+    if (sp->img) cv_mark(sp->x, sp->y, sp->w, sp->h); // background shows through where it was
+    sp->img = img;
+    sp->x = x;
+    sp->y = y;
+    sp->w = w;
+    sp->h = h;
+    if (img) cv_mark(x, y, w, h);
+}
+
+void canvas_flush(void) {
+    unsigned int t, tx, ty, a, b, m, x0, x1, y0, y1, d;
+    t = _CP0_GET_COUNT();
+    if (cv_fb == 0) return;
+    oled_wait(); // frame may still be going out from last time
+    for (ty = cv_y / oled_tile; ty <= (cv_y + cv_h - 1) / oled_tile; ty++) {
+        d = cv_dirty[ty];
+        while (d) { // rebuild each run of dirty tiles in this row
+            for (a = 0; !(d & 1 << a); a++);
+            for (b = a; (b != oled_tilesx - 1) && (d & 1 << (b + 1)); b++);
+            m = (2 << b) - (1 << a);
+            d &= ~m;
+            x0 = (a * oled_tile > cv_x) ? a * oled_tile : cv_x;
+            x1 = (b * oled_tile + oled_tile < cv_x + cv_w) ? b * oled_tile + oled_tile : cv_x + cv_w;
+            y0 = (ty * oled_tile > cv_y) ? ty * oled_tile : cv_y;
+            y1 = (ty * oled_tile + oled_tile < cv_y + cv_h) ? ty * oled_tile + oled_tile : cv_y + cv_h;
+            cv_compose(x0 - cv_x, y0 - cv_y, x1 - cv_x, y1 - cv_y);
+            for (tx = a; tx <= b; tx++) oled_tilesig[ty][tx] = 0; // img_diff no longer knows what's there
+        }
+    }
+
+    oled_img = cv_fb; // set up as dispimage would for an img_mono image
+    oled_xsize = cv_w;
+    oled_ysize = cv_h;
+#if oled_upscan==1
+    oled_format = img_mono | img_revscan;
+#else
+    oled_format = img_mono;
+#endif
+    oled_direct = 0;
+    oled_conv = oled_convtab[1][0];
+    oled_step = 1;
+    oled_scaleconv = 0;
+    oled_sendtiles(t, cv_x, cv_y, cv_h, cv_dirty);
+    oled_wait();
+}
+
+static unsigned int con_colour(unsigned int c) { // primarycol index for colour, or nearest primary
+    unsigned int i;
+    for (i = 0; i != 16; i++) if (primarycol[i] == c) return (i);
+    return (((c & 0x8000) ? 1 : 0) | ((c & 0x400) ? 2 : 0) | ((c & 0x10) ? 4 : 0));
+}
+
+static void con_blank(unsigned int y) { // screen cleared to bgcol from y down, so rows from there show spaces
+#if con_lines
+    unsigned int r, c;
+    for (r = (y + vspace - 1) / vspace; r < con_rows; r++)
+        for (c = 0; c != con_cols; c++) {
+            con_shown[r][c] = ' ';
+            con_shownattr[r][c] = con_colour(bgcol) << 4;
+        }
+#endif
+}
+
+static void con_showrun(void) { // text run just sent, so those screen cells now show it
+#if con_lines
+    unsigned int r, c, i, a;
+    if ((oled_textfont != &font6x8) || (oled_textx % charwidth) || (oled_texty % vspace) || (oled_texty / vspace >= con_rows)) return;
+    r = oled_texty / vspace;
+    a = con_colour(oled_textfg) | con_colour(oled_textbg) << 4;
+    for (i = 0, c = oled_textx / charwidth; (i != oled_textlen) && (c != con_cols); i++, c++) {
+        con_shown[r][c] = oled_text[i] + startchar;
+        con_shownattr[r][c] = a;
+    }
+#endif
+}
+
+static void oled_textflush(void) { // send pending text run
+    unsigned int t, x, y, b, n, w, h;
+
+    n = oled_textlen;
+    if (n == 0) return;
+    t = _CP0_GET_COUNT();
+    w = oled_textfont->width;
+    h = oled_textfont->height;
+    oled_invalidate(oled_textx, oled_texty, n * w, h);
+    if ((n * w * h > charwidth * charheight) || (oled_texty + h > dispheight) || (((oled_texty + oled_scroll) & (dispheight - 1)) + h > dispheight)) {
+        oled_format = oled_fmt_text; // line at a time by DMA, which can clip & split
+        oled_direct = 0;
+        oled_xsize = n * w;
+        oled_ysize = h;
+        oled_area(t, oled_textx, oled_texty, n * w, h, 0, oled_texty, h);
+        con_showrun();
+        oled_textlen = 0;
+        return;
+    }
+    // single small glyph is quicker to just write out than take a DMA int per row for
+    oled_window(oled_textx, oled_texty, w, h);
+    oled_spibytes += w * h * 2;
+    SPI1CONbits.MODE16 = 1; // 16 bit SPI so 1 transfer per pixel
+    oled_cd_hi;
+    oled_cs_lo;
+    for (y = 0; y != h; y++) {
+#if oled_upscan==1
+        b = oled_glyphrow(oled_text[0], h - 1 - y); //lookup outside loop for speed    
+#else
+        b = oled_glyphrow(oled_text[0], y); //lookup outside loop for speed  
+#endif          
+        for (x = 0; x != w; x++) {
+            while (SPI1STATbits.SPITBF);
+            SPI1BUF = (b & 0x80000000) ? oled_textfg : oled_textbg;
+            b <<= 1;
+        }
+    } //y
+    while (SPI1STATbits.SPIBUSY); // wait until last byte sent before releasing CS
+    SPI1CONbits.MODE16 = 0;
     oled_cs_hi;
+    con_showrun();
+    oled_textlen = 0;
+}
 
+void dispscroll(int dy) {
+    oled_wait();
+    oled_scroll = (oled_scroll + dy) & (dispheight - 1);
+    oledcmd(0x1a1); // display start line
+#if oled_upscan==1
+    oledcmd((dispheight - oled_scroll) & (dispheight - 1));
+#else
+    oledcmd(oled_scroll);
+#endif
+    oled_forgettiles(0, 0, dispwidth, dispheight); // everything has moved
+#if con_lines
+    unsigned int i, r, s, c, k;
+    if (dy % vspace) { // off the cell grid
+        con_forget(0, 0, dispwidth, dispheight);
+        return;
+    }
+    k = (dy < 0) ? -dy / vspace : dy / vspace;
+    for (i = 0; i != con_rows; i++) { // move the shadow with the screen
+        r = (dy > 0) ? i : con_rows - 1 - i; // in the order that reads each row before it's overwritten
+        s = (dy > 0) ? r + k : r - k; // where it came from. Rows that came round from the other side are unknown
+        for (c = 0; c != con_cols; c++) {
+            con_shown[r][c] = (s < con_rows) ? con_shown[s][c] : con_unknown;
+            con_shownattr[r][c] = (s < con_rows) ? con_shownattr[s][c] : 0;
+        }
+    }
+#endif
 }
 
-void _mon_putc(char c) // STDIO for printf
-{
-    dispchar(c);
+static void oled_newline(void) {
+    unsigned int d;
+    dispx = 0;
+    dispy += oled_font->height + vspace - charheight;
+    if (!dispconsole) {
+        if (dispy >= dispheight) dispy = 0;
+        return;
+    }
+    if (dispy + oled_font->height <= dispheight) return;
+    d = dispy + oled_font->height - dispheight;
+    oled_textflush(); // pending run is where it was before the scroll
+    dispscroll(d);
+#if con_lines
+    con_top += (d + vspace - 1) / vspace;
+#endif
+    dispy -= d;
+    plotblock(0, dispheight - d, dispwidth, d, bgcol); // clear what came round from the top
+    con_blank(dispheight - d);
 }
 
-void dispchar(unsigned char c) {// display 1 character, do control characters
-    unsigned int x, y, b, m;
+static void oled_putc(unsigned char c) { // display 1 character, do control characters. Glyphs are left in the pending run
+    unsigned int x;
 
     if (dispuart) {
       
@@ -247,6 +899,10 @@ void dispchar(unsigned char c) {// display 1 character, do control characters
         else u2txbyte(c); //UART mode
         if(!(dispuart & dispuart_screen) ) return;
     }
+#if con_lines
+    if (con_back && !con_drawing && (c != 12)) dispscrollback(-(int) con_back); // output goes on the live view. CLS just forgets it was scrolled back
+#endif
+    if ((c < startchar) || (c >= nchars_6x8 + startchar)) oled_textflush(); // control codes may move, recolour or draw
 
     switch (c) { // control characters
 
@@ -254,7 +910,7 @@ void dispchar(unsigned char c) {// display 1 character, do control characters
             delayus(500000);
             break;
         case 3: // half space
-            dispx += charwidth / 2;
+            dispx += oled_font->width / 2;
             break;
         case 4: // short backspace
             dispx -=3;
@@ -266,16 +922,19 @@ void dispchar(unsigned char c) {// display 1 character, do control characters
             break; // invert  
 
         case 8:// BS 
-            if (dispx >= charwidth) dispx -= charwidth;
+            if (dispx >= oled_font->width) dispx -= oled_font->width;
             break;
         case 10:// crlf 
-            dispx = 0;
-            dispy += vspace;
-            if (dispy >= dispheight) dispy = 0;
+            oled_newline();
             break;
         case 12: // CLS 
             plotblock(0, 0, dispwidth, dispheight, bgcol);
+            con_blank(0);
             dispx = dispy = 0;
+#if con_lines
+            con_back = 0; // back to the live view, with nothing to redraw
+            if (dispconsole) con_top += con_rows; // what was on screen stays in the scrollback
+#endif
             break;
         case 13:
             dispx = 0;
@@ -283,6 +942,9 @@ void dispchar(unsigned char c) {// display 1 character, do control characters
         case 14 : // grey
             fgcol=rgbto16(128,128,128);
             break;
+        case 0x10 ... 0x12: // font
+            oled_font = oled_fonts[c - 0x10];
+            break;
 
         case 0x80 ... 0x93: // tab x
             dispx = (c & 0x1f) * charwidth;
@@ -297,50 +959,121 @@ void dispchar(unsigned char c) {// display 1 character, do control characters
             break;
 
         case startchar ... (nchars_6x8 + startchar - 1): // displayed characters
-            oled_cs_lo;
-            oledcmd(0x175);
-            oledcmd(dispx);
-            oledcmd(dispx + charwidth - 1); // column address
-#if oled_upscan==1
-            oledcmd(0x115);
-            oledcmd((dispy + charheight - 1)^127);
-            oledcmd(dispy^127); // row address
-
-#else
-            oledcmd(0x115);
-            oledcmd(dispy);
-            oledcmd(dispy + charheight - 1); // row address
-#endif
-            oledcmd(0x15c); //send data  
-            SPI1CONbits.MODE16 = 1; // 16 bit SPI so 1 transfer per pixel
-            oled_cd_hi;
-            oled_cs_lo;
-            c -= startchar;
-            for (y = 0; y != charheight; y++) {
-#if oled_upscan==1
-                b = FONT6x8[c][7 - y]; //lookup outside loop for speed    
-#else
-                b = FONT6x8[c][y]; //lookup outside loop for speed  
-#endif          
-                for (x = 0; x != charwidth; x++) {
-                    while (SPI1STATbits.SPITBF);
-                    SPI1BUF = (b & 0x80) ? fgcol : bgcol;
-                    b <<= 1;
+            if (dispx + oled_font->width > dispwidth) oled_newline(); // wouldn't fit
+            if (oled_textlen && ((dispx != oled_textx + oled_textlen * oled_textfont->width) || (dispy != oled_texty) || (oled_font != oled_textfont)
+                    || (fgcol != oled_textfg) || (bgcol != oled_textbg) || (oled_textlen == oled_textmax))) oled_textflush();
+            if (oled_textlen == 0) {
+                oled_wait(); // previous run may still be going out of oled_text, and using oled_textlut
+                oled_textx = dispx;
+                oled_texty = dispy;
+                oled_textfg = fgcol;
+                oled_textbg = bgcol;
+                oled_textfont = oled_font;
+                if ((fgcol != oled_lutfg) || (bgcol != oled_lutbg)) {
+                    for (x = 0; x != 16; x++) {
+                        oled_textlut[x][0] = ((x & 8) ? fgcol : bgcol) | ((x & 4) ? fgcol : bgcol) << 16;
+                        oled_textlut[x][1] = ((x & 2) ? fgcol : bgcol) | ((x & 1) ? fgcol : bgcol) << 16;
+                    }
+                    oled_lutfg = fgcol;
+                    oled_lutbg = bgcol;
                 }
-            } //y
-            while (SPI1STATbits.SPIBUSY); // wait until last byte sent before releasing CS
-            SPI1CONbits.MODE16 = 0;
-            oled_cs_hi;
-            dispx += charwidth;
-            if (dispx >= dispwidth) {
-                dispx = 0;
-                dispy += vspace;
-                if (dispy >= dispheight) dispy = 0;
+#if con_lines
+                con_runattr = con_colour(fgcol) | con_colour(bgcol) << 4;
+#endif
             }
+#if con_lines
+            if (dispconsole && !con_drawing && (oled_font == &font6x8) && !(dispx % charwidth) && !(dispy % vspace) && (dispy / vspace < con_rows)) {
+                con_clearto(con_top + con_rows);
+                con_text[(con_top + dispy / vspace) % con_lines][dispx / charwidth] = c;
+                con_attr[(con_top + dispy / vspace) % con_lines][dispx / charwidth] = con_runattr;
+            }
+#endif
+            oled_text[oled_textlen++] = ((c >= oled_font->first) && (c < oled_font->first + oled_font->count)) ? c - oled_font->first : oled_blank;
+            dispx += oled_font->width;
+            if (dispx >= dispwidth) oled_newline();
             break;
 
     }//switch
 
-  oled_cs_hi;
+}
+
+#if con_lines
 
+static void con_redraw(void) { // make the screen show the lines in view, sending only cells that differ
+    unsigned int r, c, l, x, y, known;
+    unsigned short fg, bg;
+    const font_t* f;
+
+    oled_textflush();
+    fg = fgcol;
+    bg = bgcol;
+    x = dispx;
+    y = dispy;
+    f = oled_font;
+    con_drawing = 1;
+    oled_font = &font6x8;
+    con_clearto(con_top + con_rows);
+    for (r = 0; r != con_rows; r++) {
+        l = (con_top + r - con_back) % con_lines;
+        for (c = known = 0; c != con_cols; c++) if (con_shown[r][c] != con_unknown) known = 1;
+        if (!known && (r * vspace + vspace <= dispheight)) plotblock(0, r * vspace + charheight, dispwidth, vspace - charheight, 0); // gap below may be anything
+        for (c = 0; c != con_cols; c++)
+            if ((con_text[l][c] != con_shown[r][c]) || ((con_attr[l][c] ^ con_shownattr[r][c]) & ((con_text[l][c] == ' ') ? 0xf0 : 0xff))) { // fg doesn't show in a space
+                fgcol = primarycol[con_attr[l][c] & 15];
+                bgcol = primarycol[con_attr[l][c] >> 4];
+                dispx = c * charwidth;
+                dispy = r * vspace;
+                oled_putc(con_text[l][c]); // consecutive cells in the same colours go as one run
+            }
+    }
+    oled_textflush();
+    fgcol = fg;
+    bgcol = bg;
+    dispx = x;
+    dispy = y;
+    oled_font = f;
+    con_drawing = 0;
+}
+#endif
+
+int dispscrollback(int n) {
+#if con_lines
+    int b, k;
+    b = (int) con_back + n;
+    if (b > (int) (con_lines - con_rows)) b = con_lines - con_rows; // oldest still in the ring
+    if (b > (int) con_top) b = con_top; // or oldest there's been
+    if (b < 0) b = 0;
+    k = b - (int) con_back; // +ve : view moves back, so the screen moves down
+    if (k == 0) return (con_back);
+    oled_textflush();
+    if ((k < con_rows) && (-k < con_rows)) {
+        dispscroll(-k * vspace);
+        if (k < 0) plotblock(0, dispheight + k * vspace, dispwidth, vspace - charheight, 0); // gap of the row above the new ones came round from the top
+    } else con_forget(0, 0, dispwidth, dispheight);
+    con_back = b;
+    con_redraw();
+    return (con_back);
+#else
+    return (0);
+#endif
+}
+
+void dispfont(const font_t* f) {
+    oled_font = f ? f : &font6x8;
+}
+
+void dispchar(unsigned char c) {// display 1 character, do control characters
+    oled_putc(c);
+    oled_textflush();
+}
+
+void _mon_putc(char c) // STDIO for printf
+{
+    dispchar(c);
+}
+
+void _mon_write(const char* s, unsigned int count) // STDIO for printf, a whole formatted string or piece of one at a time
+{
+    while (count--) oled_putc(*s++);
+    oled_textflush();
 }
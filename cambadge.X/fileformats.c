@@ -5,7 +5,7 @@
 // stuff to do with AVI,BMP formats etc.
 
 unsigned long fgetword(unsigned long offset) { // get a word from offset in file
-    unsigned long d;
+    unsigned long d = 0; // in case long is 8 bytes, for host builds
     FSfseek(fptr, offset, SEEK_SET);
     FSfread(&d, 1, 4, fptr);
     return (d);
@@ -17,8 +17,83 @@ unsigned long mgetword(unsigned long offset) // return long at arbitary alignmen
     return (avibuf[offset] | ((unsigned long) avibuf[offset + 1] << 8) | ((unsigned long) avibuf[offset + 2] << 16) | ((unsigned long) avibuf[offset + 3] << 24));
 }
 
+// ______________________________________________________________ AVI index
+// Frames are found through the idx1 index, so chunks in between ( JUNK, audio, LIST rec headers) are passed over and
+// any frame can be got at directly. Reading the index just needs its place in the file, plus the idx1 entry number of
+// every av_seekstep'th video frame, found in one pass through the index at open. Where all entries between two of those
+// are video frames, as in everything the badge records, a frame's entry is found by arithmetic and read with one seek.
+// Otherwise the entries from the one before are read, at most a few hundred bytes for files under avi_seekpoints*32
+// frames. Entries are read into the top half of avibuf, as the bottom is the mono palette while playing.
+
+#define aviisframe(id) (((id) & 0xfeffffff) == 0x62643030) // 00db or 00dc chunk, stream 0 video
+
+static unsigned int av_index, av_indexlen, av_base, av_seekstep; // file offset of idx1 entries, number of them ( 0 if no index), what their offsets are from
+static unsigned int av_seektab[avi_seekpoints]; // idx1 entry number of frame n*av_seekstep
+
+static unsigned int bufword(const unsigned char* p) { // little-endian word at any alignment
+    return (p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24);
+}
+
+static void aviindex(unsigned int ofs, unsigned int movi) {
+    // read idx1 at ofs and fill in the seek table. movi is where the "movi" list type is, that offsets are usually from
+    unsigned int i, j, e, n, v, *w;
+    av_indexlen = 0;
+    if (fgetword(ofs) != 0x31786469) return; // "idx1", else no index and frames are taken to be back to back
+    n = fgetword(ofs + 4) / 16;
+    av_index = ofs + 8;
+    av_seekstep = avi_frames / avi_seekpoints + 1; // avih frame count, near enough
+    w = &headerbuf.words[hbuflen / 8];
+    for (e = v = 0; e != n; e += j) {
+        j = (n - e > hbuflen / 32) ? hbuflen / 32 : n - e;
+        if (FSfread(w, j * 16, 1, fptr) == 0) return;
+        for (i = 0; i != j; i++) {
+            if (!aviisframe(w[i * 4])) continue;
+            if (v == 0) { // first frame's entry tells which way offsets are given
+                if (w[i * 4 + 2] + movi == avi_start - 8) av_base = movi;
+                else if (w[i * 4 + 2] == avi_start - 8) av_base = 0; // some writers give file offsets
+                else return;
+            }
+            if ((v % av_seekstep == 0) && (v / av_seekstep < avi_seekpoints)) av_seektab[v / av_seekstep] = e + i;
+            v++;
+        }
+    }
+    if (v == 0) return;
+    avi_frames = v; // the index is what counts
+    av_indexlen = n;
+}
+
+static unsigned int aviframe(unsigned int k, unsigned int* len) {
+    // file offset of frame k's data, and its length. 0 if the index can't be read
+    unsigned int i, j, e, f, e2, f2, *w;
+    *len = avi_framelen;
+    if (av_indexlen == 0) return (avi_start + k * (((avi_framelen + 1) & ~1) + 8)); // frames back to back
+    i = k / av_seekstep;
+    if (i >= avi_seekpoints) i = avi_seekpoints - 1;
+    e = av_seektab[i];
+    f = i * av_seekstep;
+    e2 = (i + 1 < avi_seekpoints) && (f + av_seekstep < avi_frames) ? av_seektab[i + 1] : av_indexlen;
+    f2 = (e2 == av_indexlen) ? avi_frames : f + av_seekstep;
+    if (e2 - e == f2 - f) { // nothing but frames in between, so straight to it
+        e += k - f;
+        f = k;
+    }
+    if (FSfseek(fptr, av_index + e * 16, SEEK_SET)) return (0);
+    w = &headerbuf.words[hbuflen / 8];
+    for (; e != av_indexlen; e += j) {
+        j = (f == k) ? 1 : (av_indexlen - e > hbuflen / 32) ? hbuflen / 32 : av_indexlen - e;
+        if (FSfread(w, j * 16, 1, fptr) == 0) return (0);
+        for (i = 0; i != j; i++) {
+            if (!aviisframe(w[i * 4])) continue;
+            if (f++ != k) continue;
+            *len = w[i * 4 + 3];
+            return (av_base + w[i * 4 + 2] + 8);
+        }
+    }
+    return (0);
+}
+
 unsigned int openavi(char* filename) { // open AVI and get parameters. returns <>0 if error
-    unsigned int i, fileofs, chunknum, chunklen;
+    unsigned int i, fileofs, chunknum, chunklen, movi;
     avi_frametime = avi_frames = avi_width = avi_height = avi_bpp = 0; // ensure sensible values in case of error
 
     fptr = FSfopen(filename, FS_READ);
@@ -35,42 +110,148 @@ unsigned int openavi(char* filename) { // open AVI and get parameters. returns <
     avi_frames = mgetword(fileofs + 0x24);
     avi_width = mgetword(fileofs + 0x34);
     avi_height = mgetword(fileofs + 0x38);
+    if (mgetword(0x70) == 0x47504a4d) return (14); // MJPG stream handler, where it is after a standard size avih. No decoder here
     do {
-        fileofs = fileofs + chunklen + 8;
+        fileofs = fileofs + ((chunklen + 1) & ~1) + 8;
         chunknum = fgetword(fileofs);
         chunklen = fgetword(fileofs + 4);
-    } while ((chunknum != 0x5453494c) && (!FSfeof(fptr))); //"LIST"
+    } while (((chunknum != 0x5453494c) || (fgetword(fileofs + 8) != 0x69766f6d)) && (!FSfeof(fptr))); //"LIST" "movi", past any JUNK or INFO
     if (chunknum != 0x5453494c) return (6); //Stream LIST not found
 
     if (fgetword(fileofs + 8) != 0x69766f6d) return (7); // "movi" chunk not found
+    movi = fileofs + 8;
     fileofs += 12;
-    chunknum = fgetword(fileofs);
-    if ((chunknum & 0xfeffffff) != 0x62643030) return (8); // 00db/dc not found
-    avi_framelen = fgetword(fileofs + 4); // assume block length = frame size
+    for (i = 0; i != 16; i++) { // first frame, past any JUNK, audio or LIST rec headers
+        chunknum = fgetword(fileofs);
+        chunklen = fgetword(fileofs + 4);
+        if (aviisframe(chunknum)) break;
+        fileofs += (chunknum == 0x5453494c) ? 12 : ((chunklen + 1) & ~1) + 8; // into a LIST, over anything else
+    }
+    if (i == 16) return (8); // 00db/dc not found
+    avi_framelen = chunklen; // frames other than this size are skipped in playback
     avi_bpp = avi_framelen / (avi_width * avi_height);
     avi_start = fileofs + 8; //->start of first frame
     avi_framenum = 0;
     if ((avi_framelen + 8) > cambufsize) return (9);
-    if ((avi_bpp == 0) || (avi_bpp > 3)) return (10);
-    if (avi_width > dispwidth) return (11);
-    if (avi_height > dispheight) return (12);
+    if ((avi_bpp == 0) || (avi_bpp > 3)) return (10); // bigger than the display is OK, it's shrunk to fit
+    fileofs = movi - 8;
+    aviindex(fileofs + 8 + ((fgetword(fileofs + 4) + 1) & ~1), movi); // idx1 follows the movi LIST
+    if (avi_frames == 0) return (8);
 
     return (0);
 }
 
-unsigned int showavi(void) { // display 1 frame of AVI
-    unsigned int i;
+static void showframe(unsigned char* img, unsigned int format, unsigned int stride) { // show AVI/BMP frame, centred and shrunk to fit if too big
+    unsigned int w, h;
+    w = avi_width;
+    h = avi_height;
+    if ((w <= dispwidth) && (h <= dispheight) && (stride == w * (format & 3))) {
+        dispimage((dispwidth - w) / 2, (dispheight - h) / 2, w, h, format, img);
+        return;
+    }
+    if (w > dispwidth) {
+        h = h * dispwidth / w;
+        w = dispwidth;
+    }
+    if (h > dispheight) {
+        w = w * dispheight / h;
+        h = dispheight;
+    }
+    if (w == 0) w = 1;
+    if (h == 0) h = 1;
+    dispscaled((dispwidth - w) / 2, (dispheight - h) / 2, w, h, format | img_smooth, img, avi_width, avi_height, stride);
+}
+
+unsigned int showavi(void) { // display next frame of AVI, after aviplay_start. Returns once it's read and its display started
+    unsigned int i, n;
+    n = avi_shown;
+    i = aviplay(1);
+    while ((i == 0) && (avi_shown == n)) i = aviplay(0);
+    return (i);
+}
+
+// ______________________________________________________________ AVI playback with read-ahead
+// aviplay reads the next frame a chunk per call into one half of cambuffer while the display DMA ( SPI1) sends the other
+// half, so card ( SPI2) and display time overlap. If two frames don't fit, there's one buffer and reading waits for the
+// display. The caller counts frame periods and passes them in. A frame that's read late is still shown, but frames whose
+// time went by meanwhile are seeked over, not read, so playback keeps time instead of drifting.
+// Each frame is read with the chunk header after it, so while that's the next frame, playback just carries on reading.
+// Anything else - a skip, a seek, the end, or other chunks in between - and the next frame is looked up in the index
+
+static unsigned int ap_buflen, ap_buf, ap_got, ap_len, ap_ready, ap_seek, ap_frame, ap_due, ap_periods, ap_shown;
 
-    if (++avi_framenum == avi_frames) {
-        FSfseek(fptr, avi_start, SEEK_SET);
-        avi_framenum = 0;
+void aviplay_start(void) {
+    ap_buflen = (avi_framelen + 1 + 8 + 3) & ~3; // frame, pad and the next chunk header, word aligned for display DMA
+    ap_buf = ap_got = ap_ready = ap_frame = ap_due = ap_periods = ap_shown = 0;
+    ap_seek = 1;
+    avi_framenum = avi_shown = avi_dropped = 0;
+    avi_fps = 1000000 / avi_frametime; // until there's a measurement
+    oled_wait(); // palette may be in use
+    if (avi_bpp == 1) monopalette(16, 240); // mono AVIs use limited range
+}
+
+void aviseek(unsigned int frame) {
+    frame %= avi_frames;
+    if (frame != ap_frame) {
+        ap_frame = frame;
+        ap_ready = 0;
+        ap_seek = 1;
     }
-    if (FSfread(&cambuffer, avi_framelen + 8, 1, fptr) == 0) return (2); // +8 to ship over chunk type/length - assume it's all video frames, no audio
-    if(avi_bpp==1) monopalette(16,240); // mono AVIs use limited range
-    // for some reason, 8 bit per pixel AVIs have reversed vertical scan
-    dispimage((dispwidth - avi_width) / 2, (dispheight - avi_height) / 2, avi_width, avi_height, avi_bpp | ((avi_bpp > 1) ? img_revscan : 0), cambuffer);
-    return (0);
+    ap_due = 1;
+}
+
+unsigned int aviplay(unsigned int periods) {
+    unsigned int i, n, chunk;
+    unsigned char* p;
+
+    ap_due += periods;
+    ap_periods += periods;
+    if (ap_periods * avi_frametime >= 1000000) { // about a second's worth, so fps is a recent figure
+        avi_fps = (ap_shown * 1000000 + ap_periods * avi_frametime / 2) / (ap_periods * avi_frametime);
+        ap_periods = ap_shown = 0;
+    }
+
+    p = cambuffer + ap_buf;
+    chunk = ((avi_framelen + 1) & ~1) + 8; // frame, pad to even, and the next header
+    if (!ap_ready) { // read ahead
+        if (oled_busy && (ap_buflen * 2 > cambufsize)) return (0); // one buffer, still being displayed
+        if (ap_seek) {
+            n = aviframe(ap_frame, &ap_len);
+            if ((n == 0) || FSfseek(fptr, n, SEEK_SET)) return (2);
+            ap_seek = 0;
+            ap_got = 0;
+        }
+        if (ap_len == avi_framelen) {
+            n = chunk - ap_got;
+            if (n > avi_readchunk) n = avi_readchunk;
+            i = FSfread(p + ap_got, 1, n, fptr);
+            ap_got += i;
+            if (i != n) { // only OK for the header after the last frame, if there's no index after the frames
+                if (ap_got < chunk - 8) return (2);
+                while (ap_got != chunk) p[ap_got++] = 0;
+            }
+            if (ap_got != chunk) return (0);
+        }
+        ap_ready = 1;
+    }
+    if (ap_due == 0) return (0);
 
+    ap_due--;
+    avi_framenum = ap_frame;
+    if (ap_len == avi_framelen) {
+        showframe(p, avi_bpp | ((avi_bpp > 1) ? img_revscan : 0) | img_nowait, avi_width * avi_bpp);
+        if (ap_buflen * 2 <= cambufsize) ap_buf ^= ap_buflen; // next into the other buffer
+    } // else an empty or odd size chunk, which means show the last frame again
+    avi_shown++;
+    ap_shown++;
+    ap_got = ap_ready = 0;
+
+    n = ap_frame + 1 + ap_due; // skip any whose time has already passed
+    avi_dropped += ap_due;
+    ap_due = 0;
+    ap_seek = (n != ap_frame + 1) || (n >= avi_frames) || (ap_len != avi_framelen) || !aviisframe(bufword(p + chunk - 8)) || (bufword(p + chunk - 4) != avi_framelen);
+    ap_frame = n % avi_frames;
+    return (0);
 }
 
 unsigned int loadbmp(char *filename, unsigned int load) { // action = 0 for info, 1 for load, 2 for load & display
@@ -93,12 +274,10 @@ unsigned int loadbmp(char *filename, unsigned int load) { // action = 0 for info
     avi_bpp = 0;
     if (i == 8) avi_bpp = 1;
     else if (i == 24) avi_bpp = 3;
-    avi_framelen = avi_width * avi_height*avi_bpp;
+    avi_framelen = ((avi_width * avi_bpp + 3) & ~3) * avi_height; // lines padded to 4 bytes
     i = 0;
     if (avi_bpp == 0) i = 10;
-    if (avi_width > dispwidth) i = 11;
-    if (avi_height > dispheight) i = 12;
-    if ((avi_framelen + 8) > cambufsize) i = 9;
+    if ((avi_framelen + 8) > cambufsize) i = 9; // bigger than the display is OK if it fits in RAM, it's shrunk to fit
     if (i) {
         FSfclose(fptr);
         return (i);
@@ -121,7 +300,7 @@ unsigned int loadbmp(char *filename, unsigned int load) { // action = 0 for info
     FSfclose(fptr);
     if (i != 1) return (2);
 
-    if (load == 2) dispimage((dispwidth - avi_width) / 2, (dispheight - avi_height) / 2, avi_width, avi_height, (avi_bpp == 1) ? (img_mono |  img_revscan) : (img_rgb888 | img_revscan), cambuffer);
+    if (load == 2) showframe(cambuffer, (avi_bpp == 1) ? (img_mono | img_revscan) : (img_rgb888 | img_revscan), (avi_width * avi_bpp + 3) & ~3);
     return (0);
 
 }
@@ -135,12 +314,12 @@ void aviword(unsigned int v, unsigned int offset) { // write word to AVI buffer
 
 unsigned int writebmpheader(unsigned int xsize, unsigned int ysize, unsigned int bpp) {//bpp is BYTES per pixel 1 or 3
 
-    unsigned int i, j, k;
+    unsigned int i, k;
     for (i = 0; i != (40 + 14); avibuf[i++] = 0);
 
     avibuf[0] = 'B';
     avibuf[1] = 'M';
-    i = 4 + 40 + xsize * ysize * bpp + ((bpp == 1) ? 1024 : 0); // size
+    i = 4 + 40 + ((xsize * bpp + 3) & ~3) * ysize + ((bpp == 1) ? 1024 : 0); // size, lines padded to 4 bytes
     aviword(i, 2);
     avibuf[10] = 0x36;
     if (bpp == 1) avibuf[11] = 4; // 1024 bytes colour table
@@ -158,7 +337,7 @@ unsigned int writebmpheader(unsigned int xsize, unsigned int ysize, unsigned int
 
 
     // write pallette in 128 byte chunks due to size of avibuf
-    for (j = 0, i = 0; i != 256; i++) {
+    for (i = 0; i != 256; i++) {
 
         avibuf[0] = i;
         avibuf[1] = i;
@@ -172,53 +351,753 @@ unsigned int writebmpheader(unsigned int xsize, unsigned int ysize, unsigned int
 
 }
 
-void conv16_24(unsigned int npixels, unsigned int offset)
-//convert 16bpp RGB565 to 8BPP RGB in cambuffer +1 
+void frame_crop(frame_t* view, const frame_t* f, unsigned int x, unsigned int y, unsigned int w, unsigned int h) {
+    if (x > f->width) x = f->width;
+    if (y > f->height) y = f->height;
+    if (w > f->width - x) w = f->width - x;
+    if (h > f->height - y) h = f->height - y;
+    view->pixels = f->pixels + y * f->stride + x * (f->format & 3);
+    view->stride = f->stride;
+    view->format = f->format;
+    view->width = w;
+    view->height = h;
+}
+
+unsigned int writebmp(const frame_t* f) {
+    unsigned int i, x, y, k, n, chunk, bpp, len, pad;
+    const unsigned char zero[4] = {0, 0, 0, 0};
+    unsigned char* p;
+    bpp = ((f->format & 3) == img_rgb565) ? 3 : f->format & 3; // RGB565 is saved as 24 bit
+    len = f->width * bpp;
+    pad = ((len + 3) & ~3) - len;
+    if (writebmpheader(f->width, f->height, bpp) == 0) return (0);
+    if ((f->format & 3) != img_rgb565) {
+        if ((f->format & img_revscan) && (f->stride == len) && (pad == 0)) return (FSfwrite(f->pixels, len * f->height, 1, fptr)); // already as BMP wants
+        for (y = 0; y != f->height; y++) { // else a line at a time, BMP order
+            i = (f->format & img_revscan) ? y : f->height - 1 - y;
+            if (FSfwrite(f->pixels + i * f->stride, len, 1, fptr) == 0) return (0);
+            if (pad) if (FSfwrite(zero, pad, 1, fptr) == 0) return (0);
+        }
+        return (1);
+    }
+
+    // RGB565 : convert into avibuf in BMP line order and write a sector's worth at a time, so the frame is left as it was
+    // and there's no whole-frame conversion pass before the first write. Chunks end on sector boundaries ( the header
+    // is 54 bytes), so each write hands the FS whole sectors rather than splitting one across two calls
+    chunk = 512 - (40 + 14);
+    for (y = n = 0; y != f->height; y++) {
+        p = f->pixels + ((f->format & img_revscan) ? y : f->height - 1 - y) * f->stride;
+        for (x = 0; x != f->width; x += k) {
+            if (n >= chunk) {
+                if (FSfwrite(avibuf, chunk, 1, fptr) == 0) return (0);
+                for (i = 0; chunk + i != n; i++) avibuf[i] = avibuf[chunk + i]; // part pixel and padding left over
+                n -= chunk;
+                chunk = 512;
+            }
+            k = (chunk - n + 2) / 3; // pixels to fill the chunk, the last one may run past it
+            if (k > f->width - x) k = f->width - x;
+            conv16_24line(p + x * 2, avibuf + n, k);
+            n += k * 3;
+        }
+        for (i = 0; i != pad; i++) avibuf[n++] = 0;
+    }
+    return (FSfwrite(avibuf, n, 1, fptr)); // rest, up to a sector plus a few bytes
+}
+
+// ______________________________________________________________ QOI lossless images
+// "Quite OK Image" format ( qoiformat.org), 3 channel. One pass, no full-frame conversion, and the only state is the
+// previous pixel, a run count and a 64 entry table of recently seen pixels. Typically well under half the size of a BMP.
+// Pixels are kept as a8r8g8b8 words. RGB565 is widened with its top bits repeated, so it comes back exactly on loading
+
+#define qoi_index 0x00 // 00iiiiii : pixel from the table
+#define qoi_diff 0x40 // 01rrggbb : each channel -2..1 from the previous pixel
+#define qoi_luma 0x80 // 10gggggg rrrrbbbb : green -32..31, red and blue -8..7 more than green
+#define qoi_run 0xc0 // 11nnnnnn : previous pixel n+1 more times, 1-62
+#define qoi_rgb 0xfe // then r,g,b
+#define qoi_rgba 0xff // then r,g,b,a
+#define qoi_hash(p) ((((p) >> 16 & 0xff) * 3 + ((p) >> 8 & 0xff) * 5 + ((p) & 0xff) * 7 + ((p) >> 24) * 11) & 63)
+
+unsigned int writeqoi(const frame_t* f) {
+    // encode a line at a time from the frame, top down whatever its scan order, through avibuf
+    unsigned int index[64];
+    unsigned int i, n, x, y, px, prev, run, v;
+    unsigned char* p;
+    int dr, dg, db;
+
+    for (i = 0; i != 64; index[i++] = 0);
+    n = 0;
+    avibuf[n++] = 'q';
+    avibuf[n++] = 'o';
+    avibuf[n++] = 'i';
+    avibuf[n++] = 'f';
+    for (i = 0; i != 4; i++) avibuf[n++] = f->width >> (24 - i * 8); // big endian
+    for (i = 0; i != 4; i++) avibuf[n++] = f->height >> (24 - i * 8);
+    avibuf[n++] = 3; // RGB
+    avibuf[n++] = 0; // sRGB
+
+    prev = 0xff000000;
+    run = 0;
+    for (y = 0; y != f->height; y++) {
+        p = f->pixels + ((f->format & img_revscan) ? f->height - 1 - y : y) * f->stride;
+        for (x = 0; x != f->width; x++) {
+            switch (f->format & 3) {
+                case img_mono:
+                    px = 0xff000000 | *p++ * 0x010101;
+                    break;
+                case img_rgb565:
+                    v = p[0] | (unsigned int) p[1] << 8;
+                    p += 2;
+                    px = 0xff000000 | (v & 0xf800) << 8 | (v & 0xe000) << 3 | (v & 0x07e0) << 5 | (v & 0x0600) >> 1 | (v & 0x001f) << 3 | (v & 0x001c) >> 2;
+                    break;
+                default: // RGB888, B G R as conv16_24 leaves it
+                    px = 0xff000000 | p[2] << 16 | p[1] << 8 | p[0];
+                    p += 3;
+            }
+            if (n > hbuflen - 14) { // room for a run and the longest op, or a run and the end marker
+                if (FSfwrite(avibuf, n, 1, fptr) == 0) return (0);
+                n = 0;
+            }
+            if (px == prev) {
+                if (++run == 62) {
+                    avibuf[n++] = qoi_run | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run) {
+                avibuf[n++] = qoi_run | (run - 1);
+                run = 0;
+            }
+            i = qoi_hash(px);
+            if (index[i] == px) {
+                avibuf[n++] = qoi_index | i;
+            } else {
+                index[i] = px;
+                dr = (signed char) ((px >> 16) - (prev >> 16));
+                dg = (signed char) ((px >> 8) - (prev >> 8));
+                db = (signed char) (px - prev);
+                if ((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1))
+                    avibuf[n++] = qoi_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+                else if ((dg >= -32) && (dg <= 31) && (dr - dg >= -8) && (dr - dg <= 7) && (db - dg >= -8) && (db - dg <= 7)) {
+                    avibuf[n++] = qoi_luma | (dg + 32);
+                    avibuf[n++] = (dr - dg + 8) << 4 | (db - dg + 8);
+                } else {
+                    avibuf[n++] = qoi_rgb;
+                    avibuf[n++] = px >> 16;
+                    avibuf[n++] = px >> 8;
+                    avibuf[n++] = px;
+                }
+            }
+            prev = px;
+        }
+    }
+    if (run) avibuf[n++] = qoi_run | (run - 1);
+    for (i = 0; i != 8; i++) avibuf[n++] = (i == 7); // end marker
+    return (FSfwrite(avibuf, n, 1, fptr));
+}
+
+unsigned int loadqoi(char* filename, unsigned int load) {
+    // as loadbmp. Loads as RGB565 into cambuffer, streaming the file through avibuf, so can be up to cambufsize/2 pixels
+    unsigned int index[64];
+    unsigned int i, n, len, px, run, b1, b2, vg;
+    unsigned short* d;
+
+    fptr = FSfopen(filename, FS_READ);
+    if (fptr == NULL) return (1);
+    len = FSfread(&avibuf, 1, hbuflen, fptr);
+    if (len < 14) {
+        FSfclose(fptr);
+        return (2);
+    }
+    if ((avibuf[0] != 'q') || (avibuf[1] != 'o') || (avibuf[2] != 'i') || (avibuf[3] != 'f')) {
+        FSfclose(fptr);
+        return (15);
+    }
+    avi_width = avibuf[4] << 24 | avibuf[5] << 16 | avibuf[6] << 8 | avibuf[7];
+    avi_height = avibuf[8] << 24 | avibuf[9] << 16 | avibuf[10] << 8 | avibuf[11];
+    avi_bpp = avibuf[12]; // 3 or 4, as in the file
+    avi_framelen = avi_width * avi_height * 2; // once loaded
+    i = 0;
+    if ((avi_bpp < 3) || (avi_bpp > 4)) i = 10;
+    if ((avi_width > 0x4000) || (avi_height > 0x4000) || (avi_framelen > cambufsize)) i = 9; // bigger than the display is OK if it fits in RAM
+    if (i || !load) {
+        FSfclose(fptr);
+        return (i);
+    }
+
+#define qoi_byte(v) do { \
+        if (n == len) { \
+            len = FSfread(&avibuf, 1, hbuflen, fptr); \
+            n = 0; \
+            if (len == 0) { FSfclose(fptr); return (2); } \
+        } \
+        v = avibuf[n++]; \
+    } while (0)
+
+    for (i = 0; i != 64; index[i++] = 0);
+    d = cambuffer_s;
+    px = 0xff000000;
+    run = 0;
+    n = 14;
+    for (i = avi_width * avi_height; i; i--) {
+        if (run) run--;
+        else {
+            qoi_byte(b1);
+            if (b1 == qoi_rgb) {
+                qoi_byte(b2);
+                px = (px & 0xff00ffff) | b2 << 16;
+                qoi_byte(b2);
+                px = (px & 0xffff00ff) | b2 << 8;
+                qoi_byte(b2);
+                px = (px & 0xffffff00) | b2;
+            } else if (b1 == qoi_rgba) {
+                qoi_byte(b2);
+                px = b2 << 16;
+                qoi_byte(b2);
+                px |= b2 << 8;
+                qoi_byte(b2);
+                px |= b2;
+                qoi_byte(b2);
+                px |= b2 << 24;
+            } else switch (b1 & 0xc0) {
+                case qoi_index:
+                    px = index[b1];
+                    break;
+                case qoi_diff: // channels wrap, so each is done separately
+                    px = (px & 0xff000000) | (((px >> 16) + ((b1 >> 4) & 3) - 2) & 0xff) << 16 | (((px >> 8) + ((b1 >> 2) & 3) - 2) & 0xff) << 8
+                            | ((px + (b1 & 3) - 2) & 0xff);
+                    break;
+                case qoi_luma:
+                    qoi_byte(b2);
+                    vg = (b1 & 0x3f) - 32;
+                    px = (px & 0xff000000) | (((px >> 16) + vg - 8 + (b2 >> 4)) & 0xff) << 16 | (((px >> 8) + vg) & 0xff) << 8
+                            | ((px + vg - 8 + (b2 & 15)) & 0xff);
+                    break;
+                default:
+                    run = b1 & 0x3f;
+            }
+            index[qoi_hash(px)] = px;
+        }
+        *d++ = rgbto16(px >> 16, px >> 8, px);
+    }
+    FSfclose(fptr);
+    if (load == 2) showframe(cambuffer, img_rgb565, avi_width * 2);
+    return (0);
+}
+
+unsigned int writeaviframe(const frame_t* f) {
+    // Y8 (mono) AVIs are top down and limited to 16-240, RGB565 ones bottom up like BMP.
+    // Mono lines are range-mapped into avibuf on the way out, in whichever order the file needs, so the frame is left alone.
+    // As many whole lines as fit go in each write after the header, 6 at 128 wide, as FSfwrite costs a lot per call
+    unsigned int i, x, y, n, m, len, rev;
+    unsigned char* p;
+    unsigned char hdr[8];
+    len = f->width * (f->format & 3);
+    rev = ((f->format & 3) == img_mono) ? (f->format & img_revscan) : !(f->format & img_revscan); // stored in the opposite order to file
+    p = ((f->stride == len) && !rev && ((f->format & 3) != img_mono)) ? f->pixels - 8 : hdr; // packed RGB goes in one write with the header in front
+    p[0] = '0';
+    p[1] = '0';
+    p[2] = 'd';
+    p[3] = 'c';
+    p[4] = len * f->height;
+    p[5] = (len * f->height) >> 8;
+    p[6] = (len * f->height) >> 16;
+    p[7] = 0;
+    if (p != hdr) return (FSfwrite(p, len * f->height + 8, 1, fptr));
+    if ((f->format & 3) != img_mono) {
+        if (FSfwrite(hdr, 8, 1, fptr) == 0) return (0);
+        for (y = 0; y != f->height; y++)
+            if (FSfwrite(f->pixels + (rev ? f->height - 1 - y : y) * f->stride, len, 1, fptr) == 0) return (0);
+        return (1);
+    }
+    for (i = 0; i != 256; i++) avibuf[i] = 16 + i * 223 / 255; // lookup table for 0-255 range to 16-239
+    for (n = 0; n != 8; n++) avibuf[256 + n] = hdr[n]; // lines go in avibuf after the lookup table, header first
+    for (y = 0; y != f->height; y++) {
+        p = f->pixels + (rev ? f->height - 1 - y : y) * f->stride;
+        if (n && (n + len > hbuflen - 256)) { // next line won't fit whole
+            if (FSfwrite(&avibuf[256], n, 1, fptr) == 0) return (0);
+            n = 0;
+        }
+        for (x = 0; x != len; x += m) {
+            m = (len - x > hbuflen - 256 - n) ? hbuflen - 256 - n : len - x; // only lines wider than the buffer get split
+            for (i = 0; i != m; i++) avibuf[256 + n + i] = avibuf[p[x + i]];
+            n += m;
+            if (n == hbuflen - 256) {
+                if (FSfwrite(&avibuf[256], n, 1, fptr) == 0) return (0);
+                n = 0;
+            }
+        }
+    }
+    if (n) return (FSfwrite(&avibuf[256], n, 1, fptr));
+    return (1);
+}
+
+void conv16_24(frame_t* f)
+//convert 16bpp RGB565 to 8BPP RGB in place. Working back from the end, each line only overwrites RGB565 data already converted
 {
-    unsigned int i, sp, dp, r, g, b;
+    unsigned int i, sp, dp, r, g, b, y;
     unsigned char *buf;
-    buf = cambuffer + offset;
+    buf = f->pixels;
+    if (((f->format & 3) != img_rgb565) || (f->stride > f->width * 3)) return;
 
-    sp = npixels * 2;
-    dp = npixels * 3;
+    dp = f->width * f->height * 3;
+    for (y = f->height; y--;) {
+        sp = y * f->stride + f->width * 2;
+        do {
+            i = (unsigned int) buf[--sp] << 8;
+            i |= buf[--sp];
+            r = (i & 0x1f) << 3;
+            g = (i & 0x7E0) >> 3;
+            b = (i >> 8)&0xF8;
+            buf[--dp] = b;
+            buf[--dp] = g;
+            buf[--dp] = r;
+        } while (sp != y * f->stride);
+    }
+    f->format = (f->format & ~3) | img_rgb888;
+    f->stride = f->width * 3;
+}
 
-    do {
-        i = (unsigned int) buf[--sp] << 8;
-        i |= buf[--sp];
-        r = (i & 0x1f) << 3;
-        g = (i & 0x7E0) >> 3;
-        b = (i >> 8)&0xF8;
-        buf[--dp] = b;
-        buf[--dp] = g;
-        buf[--dp] = r;
-    } while (sp);
+void conv16_24line(unsigned char* src, unsigned char* dest, unsigned int npixels)
+// convert RGB565 to RGB888 into a separate buffer, same byte order as conv16_24
+{
+    unsigned int i;
+    while (npixels--) {
+        i = *src++;
+        i |= (unsigned int) *src++ << 8;
+        *dest++ = (i & 0x1f) << 3;
+        *dest++ = (i & 0x7E0) >> 3;
+        *dest++ = (i >> 8)&0xF8;
+    }
 }
 
-void flipcambuf(unsigned int xpixels, unsigned int ypixels, unsigned int offset) { // yflip camera buffer and restrict range of mono AVI
-    unsigned int i, d, x, y, sp, dp;
-    unsigned char *buf;
+void flipcambuf(frame_t* f) { // yflip frame and restrict range of mono AVI
+    unsigned int i, d, x, y;
+    unsigned char *sp, *dp;
     for(i=0;i!=256;i++) avibuf[i]=16+i*223/255; // lookup table for 0-255 range to 16-223
-    buf = cambuffer + offset;
-    for (y = 0; y != ypixels / 2; y++) {
-        sp = y*xpixels;
+    for (y = 0; y != (f->height + 1) / 2; y++) { // middle line of odd heights still needs its range changed
+        sp = f->pixels + y * f->stride;
+        dp = f->pixels + (f->height - y - 1) * f->stride;
+        if (sp == dp) {
+            for (x = 0; x != f->width; x++) sp[x] = avibuf[sp[x]];
+            break;
+        }
+        for (x = 0; x != f->width; x++) {
+            d = *sp;
+            *sp++ = avibuf[*dp];
+            *dp++ = avibuf[d];
+        }
+    }
+    f->format ^= img_revscan;
+}
+
+// ______________________________________________________________ baseline JPEG encoder, for MJPG AVIs
+// Integer DCT as libjpeg's "islow" ( Loeffler/Ligtenberg/Moschytz, 13 bit constants), quantisation by reciprocal multiply,
+// standard Annex K quantisation and Huffman tables. Mono frames are greyscale, RGB565 ones YCbCr 4:2:0 ( 16x16 MCUs)
+// Working storage is about 1.4K of stack, tables are all in flash
+
+static const unsigned char jpeg_zigzag[64] = {// natural order index of each coefficient in zigzag order
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const unsigned char jpeg_qbase[2][64] = {// quality 50 tables, natural order. luminance, chrominance
+    {16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99},
+    {17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99}
+};
+
+// Huffman tables as written to the DHT segment : count of codes of each length 1-16, then the symbols in code order
+static const unsigned char jpeg_dht_dclum[16 + 12] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const unsigned char jpeg_dht_dcchr[16 + 12] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const unsigned char jpeg_dht_aclum[16 + 162] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d,
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+static const unsigned char jpeg_dht_acchr[16 + 162] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77,
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+// the same tables as length<<16 | code, indexed by symbol, so encoding is one lookup. Unused symbols are 0
+// hosttools/mjpegbench.c checks these match the DHT tables above
+static const unsigned int jpeg_dclum[12] = {
+    0x020000, 0x030002, 0x030003, 0x030004, 0x030005, 0x030006,
+    0x04000e, 0x05001e, 0x06003e, 0x07007e, 0x0800fe, 0x0901fe,
+};
+static const unsigned int jpeg_dcchr[12] = {
+    0x020000, 0x020001, 0x020002, 0x030006, 0x04000e, 0x05001e,
+    0x06003e, 0x07007e, 0x0800fe, 0x0901fe, 0x0a03fe, 0x0b07fe,
+};
+static const unsigned int jpeg_aclum[256] = {
+    0x04000a, 0x020000, 0x020001, 0x030004, 0x04000b, 0x05001a, 0x070078, 0x0800f8,
+    0x0a03f6, 0x10ff82, 0x10ff83, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x04000c, 0x05001b, 0x070079, 0x0901f6, 0x0b07f6, 0x10ff84, 0x10ff85,
+    0x10ff86, 0x10ff87, 0x10ff88, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x05001c, 0x0800f9, 0x0a03f7, 0x0c0ff4, 0x10ff89, 0x10ff8a, 0x10ff8b,
+    0x10ff8c, 0x10ff8d, 0x10ff8e, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x06003a, 0x0901f7, 0x0c0ff5, 0x10ff8f, 0x10ff90, 0x10ff91, 0x10ff92,
+    0x10ff93, 0x10ff94, 0x10ff95, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x06003b, 0x0a03f8, 0x10ff96, 0x10ff97, 0x10ff98, 0x10ff99, 0x10ff9a,
+    0x10ff9b, 0x10ff9c, 0x10ff9d, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x07007a, 0x0b07f7, 0x10ff9e, 0x10ff9f, 0x10ffa0, 0x10ffa1, 0x10ffa2,
+    0x10ffa3, 0x10ffa4, 0x10ffa5, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x07007b, 0x0c0ff6, 0x10ffa6, 0x10ffa7, 0x10ffa8, 0x10ffa9, 0x10ffaa,
+    0x10ffab, 0x10ffac, 0x10ffad, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0800fa, 0x0c0ff7, 0x10ffae, 0x10ffaf, 0x10ffb0, 0x10ffb1, 0x10ffb2,
+    0x10ffb3, 0x10ffb4, 0x10ffb5, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0901f8, 0x0f7fc0, 0x10ffb6, 0x10ffb7, 0x10ffb8, 0x10ffb9, 0x10ffba,
+    0x10ffbb, 0x10ffbc, 0x10ffbd, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0901f9, 0x10ffbe, 0x10ffbf, 0x10ffc0, 0x10ffc1, 0x10ffc2, 0x10ffc3,
+    0x10ffc4, 0x10ffc5, 0x10ffc6, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0901fa, 0x10ffc7, 0x10ffc8, 0x10ffc9, 0x10ffca, 0x10ffcb, 0x10ffcc,
+    0x10ffcd, 0x10ffce, 0x10ffcf, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0a03f9, 0x10ffd0, 0x10ffd1, 0x10ffd2, 0x10ffd3, 0x10ffd4, 0x10ffd5,
+    0x10ffd6, 0x10ffd7, 0x10ffd8, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0a03fa, 0x10ffd9, 0x10ffda, 0x10ffdb, 0x10ffdc, 0x10ffdd, 0x10ffde,
+    0x10ffdf, 0x10ffe0, 0x10ffe1, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0b07f8, 0x10ffe2, 0x10ffe3, 0x10ffe4, 0x10ffe5, 0x10ffe6, 0x10ffe7,
+    0x10ffe8, 0x10ffe9, 0x10ffea, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x10ffeb, 0x10ffec, 0x10ffed, 0x10ffee, 0x10ffef, 0x10fff0, 0x10fff1,
+    0x10fff2, 0x10fff3, 0x10fff4, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x0b07f9, 0x10fff5, 0x10fff6, 0x10fff7, 0x10fff8, 0x10fff9, 0x10fffa, 0x10fffb,
+    0x10fffc, 0x10fffd, 0x10fffe, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+};
+static const unsigned int jpeg_acchr[256] = {
+    0x020000, 0x020001, 0x030004, 0x04000a, 0x050018, 0x050019, 0x060038, 0x070078,
+    0x0901f4, 0x0a03f6, 0x0c0ff4, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x04000b, 0x060039, 0x0800f6, 0x0901f5, 0x0b07f6, 0x0c0ff5, 0x10ff88,
+    0x10ff89, 0x10ff8a, 0x10ff8b, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x05001a, 0x0800f7, 0x0a03f7, 0x0c0ff6, 0x0f7fc2, 0x10ff8c, 0x10ff8d,
+    0x10ff8e, 0x10ff8f, 0x10ff90, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x05001b, 0x0800f8, 0x0a03f8, 0x0c0ff7, 0x10ff91, 0x10ff92, 0x10ff93,
+    0x10ff94, 0x10ff95, 0x10ff96, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x06003a, 0x0901f6, 0x10ff97, 0x10ff98, 0x10ff99, 0x10ff9a, 0x10ff9b,
+    0x10ff9c, 0x10ff9d, 0x10ff9e, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x06003b, 0x0a03f9, 0x10ff9f, 0x10ffa0, 0x10ffa1, 0x10ffa2, 0x10ffa3,
+    0x10ffa4, 0x10ffa5, 0x10ffa6, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x070079, 0x0b07f7, 0x10ffa7, 0x10ffa8, 0x10ffa9, 0x10ffaa, 0x10ffab,
+    0x10ffac, 0x10ffad, 0x10ffae, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x07007a, 0x0b07f8, 0x10ffaf, 0x10ffb0, 0x10ffb1, 0x10ffb2, 0x10ffb3,
+    0x10ffb4, 0x10ffb5, 0x10ffb6, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0800f9, 0x10ffb7, 0x10ffb8, 0x10ffb9, 0x10ffba, 0x10ffbb, 0x10ffbc,
+    0x10ffbd, 0x10ffbe, 0x10ffbf, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0901f7, 0x10ffc0, 0x10ffc1, 0x10ffc2, 0x10ffc3, 0x10ffc4, 0x10ffc5,
+    0x10ffc6, 0x10ffc7, 0x10ffc8, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0901f8, 0x10ffc9, 0x10ffca, 0x10ffcb, 0x10ffcc, 0x10ffcd, 0x10ffce,
+    0x10ffcf, 0x10ffd0, 0x10ffd1, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0901f9, 0x10ffd2, 0x10ffd3, 0x10ffd4, 0x10ffd5, 0x10ffd6, 0x10ffd7,
+    0x10ffd8, 0x10ffd9, 0x10ffda, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0901fa, 0x10ffdb, 0x10ffdc, 0x10ffdd, 0x10ffde, 0x10ffdf, 0x10ffe0,
+    0x10ffe1, 0x10ffe2, 0x10ffe3, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0b07f9, 0x10ffe4, 0x10ffe5, 0x10ffe6, 0x10ffe7, 0x10ffe8, 0x10ffe9,
+    0x10ffea, 0x10ffeb, 0x10ffec, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x000000, 0x0e3fe0, 0x10ffed, 0x10ffee, 0x10ffef, 0x10fff0, 0x10fff1, 0x10fff2,
+    0x10fff3, 0x10fff4, 0x10fff5, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+    0x0a03fa, 0x0f7fc3, 0x10fff6, 0x10fff7, 0x10fff8, 0x10fff9, 0x10fffa, 0x10fffb,
+    0x10fffc, 0x10fffd, 0x10fffe, 0x000000, 0x000000, 0x000000, 0x000000, 0x000000,
+};
+
+
+static unsigned char *jpeg_out, *jpeg_end; // output pointer, end of output buffer. jpeg_out passes jpeg_end on overflow
+static unsigned int jpeg_acc, jpeg_nbits; // bits not yet written, LSB aligned
+
+static void jpeg_bits(unsigned int v, unsigned int n) { // append n bits ( n <= 16) to the entropy coded data, stuffing a 0 after any 0xff
+    unsigned int b;
+    jpeg_acc = (jpeg_acc << n) | v;
+    jpeg_nbits += n;
+    while (jpeg_nbits >= 8) {
+        jpeg_nbits -= 8;
+        b = (jpeg_acc >> jpeg_nbits) & 0xff;
+        if (jpeg_out < jpeg_end) *jpeg_out = b;
+        jpeg_out++;
+        if (b == 0xff) {
+            if (jpeg_out < jpeg_end) *jpeg_out = 0;
+            jpeg_out++;
+        }
+    }
+}
 
-        dp = (ypixels - y - 1) * xpixels;
+static void jpeg_bytes(const unsigned char* s, unsigned int n) { // append marker segment bytes
+    while (n--) {
+        if (jpeg_out < jpeg_end) *jpeg_out = *s;
+        jpeg_out++;
+        s++;
+    }
+}
+
+static void jpeg_marker(unsigned int marker, unsigned int len) { // start a marker segment, len is the segment length field
+    unsigned char m[4];
+    m[0] = 0xff;
+    m[1] = marker;
+    m[2] = len >> 8;
+    m[3] = len;
+    jpeg_bytes(m, len ? 4 : 2);
+}
+
+#define jpeg_cbits 13 // DCT constant precision
+#define jpeg_pbits 2 // extra precision kept between passes
+#define jpeg_descale(x, n) (((x) + (1 << ((n) - 1))) >> (n))
 
-        for (x = 0; x != xpixels; x++) {
-            d = buf[sp];
-            buf[sp++] = avibuf[buf[dp]];
-            buf[dp++] = avibuf[d];
+static void jpeg_fdct(short* d) {
+    // forward DCT in place, output is 8x the true coefficients. Rows then columns, the same arithmetic each way apart from scaling
+    int t0, t1, t2, t3, t4, t5, t6, t7, t10, t11, t12, t13, z1, z2, z3, z4, z5;
+    unsigned int i, s, pass;
+    short* p;
+    for (pass = 0; pass != 2; pass++) {
+        s = pass ? 8 : 1; // step between elements
+        for (i = 0; i != 8; i++) {
+            p = d + (pass ? i : i * 8);
+            t0 = p[0] + p[7 * s];
+            t7 = p[0] - p[7 * s];
+            t1 = p[s] + p[6 * s];
+            t6 = p[s] - p[6 * s];
+            t2 = p[2 * s] + p[5 * s];
+            t5 = p[2 * s] - p[5 * s];
+            t3 = p[3 * s] + p[4 * s];
+            t4 = p[3 * s] - p[4 * s];
+
+            t10 = t0 + t3;
+            t13 = t0 - t3;
+            t11 = t1 + t2;
+            t12 = t1 - t2;
+            z1 = (t12 + t13) * 4433; // 0.541196100
+            if (pass == 0) {
+                p[0] = (t10 + t11) << jpeg_pbits;
+                p[4 * s] = (t10 - t11) << jpeg_pbits;
+                p[2 * s] = jpeg_descale(z1 + t13 * 6270, jpeg_cbits - jpeg_pbits); // 0.765366865
+                p[6 * s] = jpeg_descale(z1 - t12 * 15137, jpeg_cbits - jpeg_pbits); // 1.847759065
+            } else {
+                p[0] = jpeg_descale(t10 + t11, jpeg_pbits);
+                p[4 * s] = jpeg_descale(t10 - t11, jpeg_pbits);
+                p[2 * s] = jpeg_descale(z1 + t13 * 6270, jpeg_cbits + jpeg_pbits);
+                p[6 * s] = jpeg_descale(z1 - t12 * 15137, jpeg_cbits + jpeg_pbits);
+            }
+
+            z1 = t4 + t7;
+            z2 = t5 + t6;
+            z3 = t4 + t6;
+            z4 = t5 + t7;
+            z5 = (z3 + z4) * 9633; // 1.175875602
+            t4 *= 2446; // 0.298631336
+            t5 *= 16819; // 2.053119869
+            t6 *= 25172; // 3.072711026
+            t7 *= 12299; // 1.501321110
+            z1 *= -7373; // 0.899976223
+            z2 *= -20995; // 2.562915447
+            z3 = z3 * -16069 + z5; // 1.961570560
+            z4 = z4 * -3196 + z5; // 0.390180644
+            z5 = pass ? jpeg_cbits + jpeg_pbits : jpeg_cbits - jpeg_pbits;
+            p[7 * s] = jpeg_descale(t4 + z1 + z3, z5);
+            p[5 * s] = jpeg_descale(t5 + z2 + z4, z5);
+            p[3 * s] = jpeg_descale(t6 + z2 + z3, z5);
+            p[s] = jpeg_descale(t7 + z1 + z4, z5);
         }
     }
+}
 
+static int jpeg_block(short* d, const unsigned short* q, int dc, const unsigned int* dctab, const unsigned int* actab) {
+    // DCT, quantise and Huffman code one block of level-shifted samples. q is divisor, reciprocal pairs. Returns the DC value for the next block's prediction
+    int v, run;
+    unsigned int k, a, n;
+    jpeg_fdct(d);
+    run = 0;
+    for (k = 0; k != 64; k++) {
+        v = d[jpeg_zigzag[k]];
+        a = (v < 0) ? -v : v;
+        a = ((a + (q[k * 2] >> 1)) * q[k * 2 + 1]) >> 16;
+        v = (v < 0) ? -(int) a : (int) a;
+        if (k == 0) {
+            n = v;
+            v -= dc; // DC is coded as the difference from the previous block of the same component
+            dc = n;
+        } else if (v == 0) {
+            run++;
+            continue;
+        }
+        for (n = 0, a = (v < 0) ? -v : v; a; a >>= 1) n++; // size category
+        if (v < 0) v--; // negative values are sent as ones complement
+        if (k == 0) jpeg_bits(dctab[n] & 0xffff, dctab[n] >> 16);
+        else {
+            for (; run > 15; run -= 16) jpeg_bits(actab[0xf0] & 0xffff, actab[0xf0] >> 16); // run of 16 zeros
+            a = actab[run << 4 | n];
+            jpeg_bits(a & 0xffff, a >> 16);
+            run = 0;
+        }
+        if (n) jpeg_bits(v & ((1 << n) - 1), n);
+    }
+    if (run) jpeg_bits(actab[0] & 0xffff, actab[0] >> 16); // end of block
+    return (dc);
+}
+
+unsigned int jpeg_encode(const frame_t* f, unsigned int quality, unsigned char* buf, unsigned int buflen) {
+    static const unsigned char app0[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    unsigned short q[2][128]; // divisor, reciprocal pairs in zigzag order, for the DCT's x8 output
+    short blk[6][64]; // Y Y Y Y Cb Cr for colour, Y only for mono
+    int dc[3];
+    unsigned char hdr[20];
+    const unsigned char* rows[16];
+    const unsigned char* s;
+    unsigned int i, j, x, y, mx, my, mcu, ncomp, sx, v, r, g, b;
+    int rs, gs, bs;
+
+    ncomp = ((f->format & 3) == img_mono) ? 1 : 3;
+    if (((f->format & 3) == img_rgb888) || (f->width == 0) || (f->height == 0)) return (0);
+    if (quality == 0) quality = 1;
+    if (quality > 100) quality = 100;
+    quality = (quality < 50) ? 5000 / quality : 200 - quality * 2; // IJG scaling, percent of the quality 50 tables
+    for (i = 0; i != 2; i++)
+        for (j = 0; j != 64; j++) {
+            v = (jpeg_qbase[i][jpeg_zigzag[j]] * quality + 50) / 100;
+            if (v == 0) v = 1;
+            if (v > 255) v = 255;
+            q[i][j * 2] = v * 8;
+            q[i][j * 2 + 1] = (65536 + v * 8 - 1) / (v * 8);
+        }
+
+    jpeg_out = buf;
+    jpeg_end = buf + buflen;
+    jpeg_acc = jpeg_nbits = 0;
+
+    jpeg_marker(0xd8, 0); // SOI
+    jpeg_marker(0xe0, 16); // APP0 JFIF, 1:1 aspect
+    jpeg_bytes(app0, 14);
+    jpeg_marker(0xdb, 2 + 65 * ((ncomp == 3) ? 2 : 1)); // DQT
+    for (i = 0; i != ((ncomp == 3) ? 2 : 1); i++) {
+        hdr[0] = i; // 8 bit, table i
+        jpeg_bytes(hdr, 1);
+        for (j = 0; j != 64; j++) {
+            hdr[0] = q[i][j * 2] / 8;
+            jpeg_bytes(hdr, 1);
+        }
+    }
+    jpeg_marker(0xc0, 8 + 3 * ncomp); // SOF0 baseline
+    hdr[0] = 8;
+    hdr[1] = f->height >> 8;
+    hdr[2] = f->height;
+    hdr[3] = f->width >> 8;
+    hdr[4] = f->width;
+    hdr[5] = ncomp;
+    for (i = 0; i != ncomp; i++) {
+        hdr[6 + i * 3] = i + 1; // component id
+        hdr[7 + i * 3] = (ncomp == 1) ? 0x11 : (i ? 0x11 : 0x22); // sampling factors, Y is 2x2 in colour
+        hdr[8 + i * 3] = i ? 1 : 0; // quantisation table
+    }
+    jpeg_bytes(hdr, 6 + 3 * ncomp);
+    jpeg_marker(0xc4, 2 + 2 * (17 + 12 + 17 + 162) / ((ncomp == 3) ? 1 : 2)); // DHT
+    for (i = 0; i != ((ncomp == 3) ? 2 : 1); i++) {
+        hdr[0] = i; // DC table i
+        jpeg_bytes(hdr, 1);
+        jpeg_bytes(i ? jpeg_dht_dcchr : jpeg_dht_dclum, 16 + 12);
+        hdr[0] = 0x10 | i; // AC table i
+        jpeg_bytes(hdr, 1);
+        jpeg_bytes(i ? jpeg_dht_acchr : jpeg_dht_aclum, 16 + 162);
+    }
+    jpeg_marker(0xda, 6 + 2 * ncomp); // SOS
+    hdr[0] = ncomp;
+    for (i = 0; i != ncomp; i++) {
+        hdr[1 + i * 2] = i + 1;
+        hdr[2 + i * 2] = i ? 0x11 : 0x00; // DC, AC tables
+    }
+    hdr[1 + ncomp * 2] = 0; // spectral selection 0-63, no approximation
+    hdr[2 + ncomp * 2] = 63;
+    hdr[3 + ncomp * 2] = 0;
+    jpeg_bytes(hdr, 4 + ncomp * 2);
+
+    mcu = (ncomp == 3) ? 16 : 8;
+    dc[0] = dc[1] = dc[2] = 0;
+    for (my = 0; my < f->height; my += mcu) {
+        for (y = 0; y != mcu; y++) { // lines of this MCU row, top down, repeating the last line past the bottom
+            i = (my + y < f->height) ? my + y : f->height - 1;
+            rows[y] = f->pixels + ((f->format & img_revscan) ? f->height - 1 - i : i) * f->stride;
+        }
+        for (mx = 0; mx < f->width; mx += mcu) {
+            if (ncomp == 1) {
+                for (y = 0; y != 8; y++)
+                    for (x = 0; x != 8; x++) {
+                        sx = (mx + x < f->width) ? mx + x : f->width - 1;
+                        blk[0][y * 8 + x] = rows[y][sx] - 128;
+                    }
+                dc[0] = jpeg_block(blk[0], q[0], dc[0], jpeg_dclum, jpeg_aclum);
+            } else {
+                for (y = 0; y != 16; y += 2)
+                    for (x = 0; x != 16; x += 2) { // a 2x2 at a time, as chroma is their average
+                        rs = gs = bs = 0;
+                        for (i = 0; i != 4; i++) {
+                            j = (y + (i >> 1)) * 16 + x + (i & 1); // pixel within MCU
+                            sx = (mx + (j & 15) < f->width) ? mx + (j & 15) : f->width - 1;
+                            s = rows[j >> 4] + sx * 2;
+                            v = s[0] | (unsigned int) s[1] << 8;
+                            r = (v >> 8) & 0xf8; // RGB565 to 8 bits, top bits repeated into the bottom so white is 255
+                            r |= r >> 5;
+                            g = (v >> 3) & 0xfc;
+                            g |= g >> 6;
+                            b = (v << 3) & 0xf8;
+                            b |= b >> 5;
+                            blk[(j >> 7) * 2 + ((j >> 3) & 1)][((j >> 4) & 7) * 8 + (j & 7)] = ((19595 * r + 38470 * g + 7471 * b + 32768) >> 16) - 128;
+                            rs += r;
+                            gs += g;
+                            bs += b;
+                        }
+                        j = (y >> 1) * 8 + (x >> 1);
+                        blk[4][j] = (-11059 * rs - 21709 * gs + 32768 * bs + (1 << 17)) >> 18; // 16 bit fractions, /4 for the average
+                        blk[5][j] = (32768 * rs - 27439 * gs - 5329 * bs + (1 << 17)) >> 18;
+                    }
+                for (i = 0; i != 4; i++) dc[0] = jpeg_block(blk[i], q[0], dc[0], jpeg_dclum, jpeg_aclum);
+                dc[1] = jpeg_block(blk[4], q[1], dc[1], jpeg_dcchr, jpeg_acchr);
+                dc[2] = jpeg_block(blk[5], q[1], dc[2], jpeg_dcchr, jpeg_acchr);
+            }
+            if (jpeg_out > jpeg_end) return (0); // give up early if it's not going to fit
+        }
+    }
+    jpeg_bits(0x7f, 7); // pad last byte with 1s
+    jpeg_marker(0xd9, 0); // EOI
+    if (jpeg_out > jpeg_end) return (0);
+    return (jpeg_out - buf);
+}
+
+unsigned int writemjpgframe(const frame_t* f, unsigned char* buf, unsigned int buflen) {
+    // JPEG encode into buf after room for the chunk header, then write header, frame and pad byte in one go.
+    // A frame too big for buf is tried again at lower quality rather than lost
+    unsigned int q, len;
+    if (buflen < 16) return (0);
+    q = avi_quality;
+    while ((len = jpeg_encode(f, q, buf + 8, buflen - 9)) == 0) { // -9 leaves room for a pad byte
+        if (q <= 1) return (0);
+        q /= 2;
+    }
+    buf[0] = '0';
+    buf[1] = '0';
+    buf[2] = 'd';
+    buf[3] = 'c';
+    buf[4] = len;
+    buf[5] = len >> 8;
+    buf[6] = len >> 16;
+    buf[7] = 0;
+    if (len > avi_framelen) avi_framelen = len; // biggest so far, for the header
+    if (len & 1) buf[8 + len++] = 0; // RIFF chunks are word aligned
+    if (FSfwrite(buf, len + 8, 1, fptr) == 0) return (0);
+    return (len + 8);
 }
 
 unsigned int startavi(void) { // reserve space for AVI header
-    return (FSfwrite(&avibuf[0], (avi_bpp == 2) ? 0xEC : 0xE0, 1, fptr) == 0);
+    return (FSfwrite(&avibuf[0], ((avi_bpp == 2) && !avi_quality) ? 0xEC : 0xE0, 1, fptr) == 0);
 }
 
 unsigned int finishavi(void) {// write index table and fill in AVI header
-    unsigned int i;
+    unsigned int i, j, n, len, ofs, hdrlen, movilen, masks;
+    masks = (avi_bpp == 2) && !avi_quality; // RGB565 has colour masks after the bitmap header
+    hdrlen = masks ? 0xEC : 0xE0; // as startavi
+    movilen = FSftell(fptr) - hdrlen + 4; // from "movi" to the end of the last chunk
     for (i = 0; i != 0x100; avibuf[i++] = 0);
 
     // write index first as we're already at right place in file
@@ -227,26 +1106,31 @@ unsigned int finishavi(void) {// write index table and fill in AVI header
 
     if (FSfwrite(&avibuf[0], 8, 1, fptr) == 0) return (1);
 
-    aviword(0x63643030, 0); // 00dc
-    aviword(0x10, 4); // length
-    aviword(avi_framelen, 12); // length
-
-    for (i = 0; i != avi_frames; i++) {
-        aviword((avi_framelen + 8) * i + 4, 8);
-
-        if (FSfwrite(&avibuf[0], 16, 1, fptr) == 0) return (2);
-
+    ofs = hdrlen; // file offset of first chunk
+    for (i = 0; i != avi_frames; i += n) { // a bufferful of entries at a time
+        n = (avi_frames - i > hbuflen / 16) ? hbuflen / 16 : avi_frames - i;
+        for (j = 0; j != n; j++) {
+            len = avi_quality ? fgetword(ofs + 4) : avi_framelen; // MJPG chunks vary in size, so read their lengths back
+            aviword(0x63643030, j * 16); // 00dc
+            aviword(0x10, j * 16 + 4); // keyframe
+            aviword(ofs - hdrlen + 4, j * 16 + 8); // offset from "movi"
+            aviword(len, j * 16 + 12);
+            ofs += len + 8 + (avi_quality ? (len & 1) : 0);
+        }
+        if (avi_quality) if (FSfseek(fptr, 0, SEEK_END)) return (2);
+        if (FSfwrite(&avibuf[0], n * 16, 1, fptr) == 0) return (2);
     }
+    len = FSftell(fptr);
 
     if (FSfseek(fptr, 0, SEEK_SET)) return (3); // go to start of file to do header
+    for (i = 0; i != 0x100; avibuf[i++] = 0);
 
     aviword(0x46464952, 0); // RIFF
-    // +4 = total file length-8  - calc from framesize, bpp and #frames
-    aviword(avi_frames * (avi_framelen + 0x18)+((avi_bpp == 2) ? 0xec : 0xe0), 0x04);
+    aviword(len - 8, 0x04); // total file length-8
 
     aviword(0x20495641, 8); // AVI 
     aviword(0x5453494c, 0x0c); //LIST
-    aviword((avi_bpp == 2) ? 0xCC : 0xC0, 0x10); // length of all header sections
+    aviword(masks ? 0xCC : 0xC0, 0x10); // length of all header sections
 
     aviword(0x6c726468, 0x14); // hdrl
     aviword(0x68697661, 0x18); //avih
@@ -254,7 +1138,7 @@ unsigned int finishavi(void) {// write index table and fill in AVI header
     if (avi_frametime == 0) avi_frametime = 10; // avoid divby0 if not set up
     aviword(avi_frametime, 0x20); // framerate
 
-    aviword(avi_framelen * 1000000 / avi_frametime, 0x24); // max bytes/sec
+    aviword((unsigned long long) (avi_framelen + 8) * 1000000 / avi_frametime, 0x24); // max bytes/sec, 64 bit so it neither overflows nor truncates to 0 below 1fps
     //40 padding granularity
     aviword(0x10, 0x2c); // flags has_index
     aviword(avi_frames, 0x30);
@@ -266,12 +1150,13 @@ unsigned int finishavi(void) {// write index table and fill in AVI header
     aviword(avi_height, 0x44);
     //72,76,80,84 unused
     aviword(0x5453494c, 0x58); //LIST
-    aviword((avi_bpp == 2) ? 0x80 : 0x74, 0x5c); //92 length of LIST - TBD
+    aviword(masks ? 0x80 : 0x74, 0x5c); //92 length of LIST - TBD
     aviword(0x6c727473, 0x60); // strl
     aviword(0x68727473, 0x64); // strh8
     aviword(0x38, 0x68); // length of vids
     aviword(0x73646976, 0x6c); // vids
-    if (avi_bpp == 1) aviword(0x20203859, 0x70); // stream type Y8
+    if (avi_quality) aviword(0x47504a4d, 0x70); // stream type MJPG
+    else if (avi_bpp == 1) aviword(0x20203859, 0x70); // stream type Y8
     else aviword(0x73646976, 0x70); // stream type vids
 
 
@@ -288,21 +1173,22 @@ unsigned int finishavi(void) {// write index table and fill in AVI header
     aviword(avi_height, 0xa2);
 
     aviword(0x66727473, 0xa4); // strf
-    aviword((avi_bpp == 2) ? 0x34 : 0x28, 0xa8); //length
+    aviword(masks ? 0x34 : 0x28, 0xa8); //length
 
     // bitmap header
     aviword(0x28, 0xac); //length
     aviword(avi_width, 0xb0);
     aviword(avi_height, 0xb4);
     aviword(1, 0xb8); //planes
-    aviword(avi_bpp * 8, 0xba); //bpp
+    aviword(avi_quality ? 24 : avi_bpp * 8, 0xba); //bpp, of the decoded image for MJPG
     //208 compression
-    if (avi_bpp == 1) aviword(0x20203859, 0xbc); // Y8
-    if (avi_bpp == 2) aviword(3, 0xbc); // rgb565
+    if (avi_quality) aviword(0x47504a4d, 0xbc); // MJPG
+    else if (avi_bpp == 1) aviword(0x20203859, 0xbc); // Y8
+    else aviword(3, 0xbc); // rgb565
 
-    aviword(avi_framelen, 0xc0);
+    aviword(avi_quality ? avi_width * avi_height * 3 : avi_framelen, 0xc0);
     i = 0xd4;
-    if (avi_bpp == 2) {// colour bit masks for RGB565 ( from looking at virtualdub output)
+    if (masks) {// colour bit masks for RGB565 ( from looking at virtualdub output)
         aviword(0x0000f800, 0xd4);
         aviword(0x000007E0, 0xd8);
         aviword(0x0000001F, 0xdc);
@@ -311,7 +1197,7 @@ unsigned int finishavi(void) {// write index table and fill in AVI header
 
     aviword(0x5453494C, i);
     i += 4; //LIST
-    aviword((avi_framelen + 8) * avi_frames + 4, i);
+    aviword(movilen, i);
     i += 4;
     aviword(0x69766f6d, i);
     i += 4; // movi
@@ -8,6 +8,19 @@ volatile unsigned int linecnt, camaddr; // camera status
 volatile unsigned int xstart, ystart, xdiv, ydiv, xpixels, ypixels; // camera parameters etc.
 unsigned int cammode, camflags, camoffset;
 unsigned int cammax;
+volatile unsigned char camring, cam_slot = camslot_none; // frame ring
+unsigned int cam_nslots, cam_slotaddr[camring_maxslots];
+volatile unsigned char cam_slotstate[camring_maxslots];
+volatile unsigned int cam_slotseq[camring_maxslots], cam_frameseq, cam_drops;
+volatile unsigned int cam_slottime[camring_maxslots], cam_vsperiod; // frame timing
+unsigned int cam_linestep; // line queue
+volatile unsigned int cam_lineq[camlineq_len], cam_lineqhead, cam_lineqtail, cam_lineqdrops;
+unsigned int cam_histstep; // histogram
+volatile unsigned short cam_hist[camhist_bins];
+volatile unsigned int cam_histtotal;
+volatile unsigned char cam_histready;
+unsigned int cam_i2ccount, cam_switchi2c; // camera register access counts
+volatile unsigned int cam_hsmax, cam_dmamax; // ISR timing
 
 #if serialcontrol==1
 volatile unsigned int rxptr = 0, rxtimer; //  UART2 receive pointer & framing timeout
@@ -16,16 +29,22 @@ unsigned char rxbuf[rxbufsize]; // UART2 receive buffer
 
 unsigned char dispx, dispy; // display cursor position ( pixels))
 unsigned short fgcol, bgcol; //foreground & background colours
+volatile unsigned char oled_busy; // DMA display transfer in progress
+volatile unsigned int oled_xfertime, oled_cputime; // display transfer timing
+volatile unsigned int oled_spibytes; // display traffic
 unsigned int reptimer=0; // auto-repeat timer - set this to zero to disable auto-repeat
 unsigned char butstate, butpress; // current button state, and button-changed flags
 signed int accx, accy, accz; //last accelerometer data
 
+unsigned char dispconsole = 0; // scroll instead of wrap
 unsigned char dispuart = 0; // where to send PRINTF/dispchar =0 for display, 1/2 for uart1/2
 unsigned char adcclaimed = 0; //=1 if someone is using the ADC so disable battery reads
 
 unsigned int avi_width, avi_height, avi_bpp; // AVI file size, colour depth
 unsigned int avi_frametime, avi_framelen; //  AVI frame period and bytes per frame
 unsigned int avi_frames, avi_framenum, avi_start; //AVI total frames, current frame, pointer to frame data in file
+unsigned int avi_quality; // MJPG quality, 0 for uncompressed
+unsigned int avi_shown, avi_dropped, avi_fps; // playback frames shown, frames skipped, achieved frames/sec
 unsigned int battlevel; // battery voltage in mV
 unsigned int tick;
 unsigned int powerdowntimer;
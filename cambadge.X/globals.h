@@ -20,6 +20,34 @@ extern unsigned int camflags; // current camera flags. Loaded from camconfig[cam
 extern unsigned int camoffset; // capture start address offset from start of cambuffer. Sampled at vsync
 extern unsigned int cammax; // limit of camera memory - will wrap round
 
+// frame ring state, used when grab enabled with camen_ring
+extern volatile unsigned char camring; // =1 if ring mode active
+extern unsigned int cam_nslots; // number of slots in ring
+extern unsigned int cam_slotaddr[camring_maxslots]; // DMA start offset of each slot within cambuffer. Image data at +1
+extern volatile unsigned char cam_slotstate[camring_maxslots]; // camslot_xx state of each slot
+extern volatile unsigned int cam_slotseq[camring_maxslots]; // frame sequence number of each ready slot, so oldest can be found
+extern volatile unsigned char cam_slot; // slot currently being filled by DMA, camslot_none if none
+extern volatile unsigned int cam_frameseq; // count of completed frames
+extern volatile unsigned int cam_drops; // frames dropped due to no free slot or incomplete capture
+extern volatile unsigned int cam_slottime[camring_maxslots]; // core timer count when each slot completed
+extern volatile unsigned int cam_vsperiod; // core timer counts between last two vsyncs, i.e. sensor frame time
+
+// line queue, filled by dmaint as lines land in cambuffer. Use cam_linequeue/cam_getline
+extern unsigned int cam_linestep; // lines per queue entry, 0 = queue disabled
+extern volatile unsigned int cam_lineq[camlineq_len]; // queue entries : b0..15 = DMA start offset of first line, b16..31 = line number
+extern volatile unsigned int cam_lineqhead, cam_lineqtail; // free-running queue indexes, head written by ISR, tail by FG task
+extern volatile unsigned int cam_lineqdrops; // line batches lost due to queue full
+
+// luminance histogram, accumulated by dmaint as lines land so no second pass over cambuffer. Use cam_histenable/cam_gethist
+extern unsigned int cam_histstep; // sample every nth line, 0 = histogram off
+extern volatile unsigned short cam_hist[camhist_bins]; // histogram of last complete frame
+extern volatile unsigned int cam_histtotal; // number of samples in cam_hist
+extern volatile unsigned char cam_histready; // set when cam_hist updated at end of frame, cleared by cam_gethist
+
+extern unsigned int cam_i2ccount; // count of camera register I2C transactions
+extern unsigned int cam_switchi2c; // I2C transactions used by last cam_enable mode switch
+extern volatile unsigned int cam_hsmax, cam_dmamax; // worst-case hsync & line DMA ISR times in core timer ticks ( clockfreq/2). Only if isrtiming==1
+
 // _____________________________________________________________________________serial
 
 #if serialcontrol==1
@@ -84,6 +112,25 @@ extern headerbuftype headerbuf;
 #define palette headerbuf.shorts
 #define nvmbuf headerbuf
 
+// describes an image in memory, so crops and flips are just other views of the same pixels, with no copying.
+// img_revscan in format means lines are stored in BMP order, as the camera produces them. See cam_frame, frame_crop, dispframe
+
+typedef struct {
+    unsigned char* pixels; // first stored line
+    unsigned int width, height; // pixels
+    unsigned int stride; // bytes from one stored line to the next
+    unsigned int format; // img_mono, img_rgb565 or img_rgb888, plus img_revscan
+} frame_t;
+
+// font for text, glyph bitmaps in flash. See hosttools/fontgen.c for how the bigger ones are made
+typedef struct {
+    unsigned char width, height; // character cell, pixels. width must be even, 6..32
+    unsigned char first, count; // character codes it has glyphs for. Others show as a blank cell
+    const unsigned char* bits; // glyph rows, (width+7)/8 bytes each MSB leftmost, top row first, height rows per glyph
+} font_t;
+
+extern const font_t font6x8, font12x16, fontnum24x32; // fontnum24x32 only has "+,-./0123456789:"
+
 //________________________________________________________________________________ structs for filesystem
 
 extern FSFILE * fptr; // file system struct for access to current open file
@@ -108,7 +155,12 @@ extern unsigned int tick; // system ticks normally set to 1 every 20ms, but if a
 
 extern unsigned char dispx, dispy; // current cursor x,y position ( pixels) 0..127
 extern unsigned short fgcol, bgcol; // foreground and background colours , RGB565
+extern volatile unsigned char oled_busy; // =1 while a DMA display transfer is in progress. Use oled_wait() before touching its image or palette
+extern volatile unsigned int oled_xfertime, oled_cputime; // last display transfer : total time, and CPU time spent setting up & converting lines
+// in core timer ticks ( clockfreq/2). The difference is the time the foreground got back
+extern volatile unsigned int oled_spibytes; // running count of bytes sent to OLED, commands and data. Zero it to start measuring
 
+extern unsigned char dispconsole; // =1 for text to scroll the screen up when it runs off the bottom, instead of wrapping to the top
 extern unsigned char dispuart; // flag to divert printf output to UART2 for debugging 0 = normal, 1 = UART 1, 2 = UART 2
 // set bit 4 to output to serial and screen
 
@@ -119,6 +171,8 @@ unsigned char adcclaimed; //=1 if someone is using the ADC so disable battery re
 extern unsigned int avi_width, avi_height, avi_bpp; // width,height in pixels, bytes per pixel (1,2 supported for record, 1,2,3 for playback)
 extern unsigned int avi_frametime, avi_framelen, avi_frames; //uS per frame, bytes per frame, number of frames
 extern unsigned int avi_framenum, avi_start; // current frame number, file offset of image data of first frame (after 00dc chunk header)
+extern unsigned int avi_quality; // 0 to record uncompressed frames, else MJPG at this JPEG quality. avi_framelen is then the biggest frame so far
+extern unsigned int avi_shown, avi_dropped, avi_fps; // aviplay frames shown and skipped to keep time since aviplay_start, frames/sec shown over the last second or so
 
 // Added by Tyler
 extern volatile uint32_t systick_ms;
@@ -131,6 +185,7 @@ void inithardware(void); // set up all peripherals etc.
 void setupints(void); // set up interrupts
 void oledcmd(unsigned int); // Send byte to OLED - b8 set for command, clear for data
 void oled_init(void); // initialise oled
+void oled_dmanext(void); // display DMA block done - called by DMA2 int, or oled_wait if ints not running yet
 void acc_read(void); // read accelerometer
 void polluart(void); // poll for serial commands
 void enterboot(void); //enter bootloader
@@ -140,8 +195,10 @@ void selftest(void); // hardware selftest
 
 //_____________________________________________________________________ stuff that might be useful for applications
 
-void cam_setreg(unsigned char, unsigned char); // write camera register
+void cam_setreg(unsigned char, unsigned char); // write camera register. Not sent if shadow copy says it's already that value
+void cam_writereg(unsigned char, unsigned char); // write camera register, always sent
 void dispchar(unsigned char); // display character or do control code. normally used via printf
+void dispfont(const font_t* f); // font for text from now on, 0 for font6x8. Or use the fnt control codes in printf strings
 void do_delay(unsigned int); // delay in cycles, used by delayus macro
 void u1txbyte(unsigned int c); // send byte on UART 1. Enables UART1 and maps pins on first call
 void u2txbyte(unsigned int c); // send byte on UART 2
@@ -163,6 +220,51 @@ void dispimage(unsigned int xstart, unsigned int ystart, unsigned int xsize, uns
 // for 1 byte/pixel, the palette must be set up first  e.g. using monopalette(). Note this shares memory with the AVI header buffer
 // format options defined in cambadge.h
 
+void dispframe(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, const frame_t* f, unsigned int opts);
+// display frame scaled to xsize x ysize, or 1:1 if the same size. opts are extra dispimage/dispscaled format options, e.g. img_nowait
+
+void frame_crop(frame_t* view, const frame_t* f, unsigned int x, unsigned int y, unsigned int w, unsigned int h);
+// make view a w x h window of f starting at pixel x of stored line y, clipped to f. view can be f
+
+void dispscaled(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format, unsigned char* imgaddr,
+        unsigned int srcw, unsigned int srch, unsigned int stride);
+// display srcw x srch pixels from imgaddr scaled to xsize x ysize, any ratio. stride is bytes from one source line to the next,
+// so a crop is just imgaddr pointing into a bigger image. format as dispimage, plus img_smooth, but skip and vdouble are ignored
+// Source can be anywhere readable, RAM or flash. Only the srcw x srch pixels are read : smoothing reuses the last row and column
+// rather than reading past them. As dispimage, sizes aren't checked against the source, so it's up to the caller to get them right
+
+void oled_wait(void);
+// wait for any DMA display transfer to finish. All display functions do this first, so only needed before changing
+// an image or palette that was displayed with img_nowait
+
+void oled_invalidate(unsigned int x, unsigned int y, unsigned int w, unsigned int h);
+// forget what img_diff knows about this area of the display, e.g. after writing to it by some other means
+
+int dispscrollback(int n);
+// in console mode, view text n lines further back ( forward if -ve) through the last con_lines lines, clipped to what there is.
+// Returns lines now viewed back, so dispscrollback(0) just asks. Any text output goes back to the live view first, except cls, which
+// just clears it so leaving a scrolled-back console with cls doesn't redraw the screen first.
+// Only 6x8 text on the vspace/charwidth grid is kept, and only cells that differ are redrawn
+
+void dispscroll(int dy);
+// scroll whole screen up by dy rows ( down if -ve) using the display start line, so no pixels are sent. Rows scrolled into view
+// show what went out the other side until redrawn. All drawing co-ordinates stay screen-relative
+
+void canvas_init(unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned char* buf);
+// start a w x h 8bpp game canvas shown at x,y, with background cleared to 0 and no sprites. buf needs 2*w*h bytes
+// ( background, then the composed frame), normally in cambuffer. Pixels are palette indexes as for img_mono
+// all canvas co-ordinates are relative to the canvas and clipped to it
+
+void canvas_fill(int x, int y, int w, int h, unsigned int col);
+// fill block of the canvas background with palette index col
+
+void canvas_sprite(unsigned int n, int x, int y, unsigned int w, unsigned int h, const unsigned char* img);
+// show sprite n ( 0..canvas_maxsprites-1) as the w x h 8bpp image img at x,y, or hide it if img=0. canvas_clear pixels are transparent.
+// Only takes effect at the next canvas_flush, and img must stay valid while shown. To show changed pixels in the same img, hide it first
+
+void canvas_flush(void);
+// redraw the tiles touched by canvas_fill/canvas_sprite since the last flush, and send only those
+
 void plotblock(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int col);
 // plot block of solid colour (RGB565) use rgbto16 macro to convert from r,g,b, or fixed colours in primarycol[]
 
@@ -174,8 +276,20 @@ void mplotblock(unsigned int x, unsigned int y, unsigned int width, unsigned int
 void monopalette(unsigned int min, unsigned int max);
 // set up palette for mono images to greyscale between min and max
 
+unsigned int openavi(char* filename);
+// open AVI and read its header and index. returns avierrors index, 0 if OK
+
 unsigned int showavi(void);
-// display next  frame of AVI previously opened with openavi. rewinds to avi_start if avi_framenum>=avi_frames
+// display next frame of AVI previously opened with openavi and set up with aviplay_start, wrapping round at the end.
+// returns avierrors index, 0 if OK
+
+void aviplay_start(void);
+// set up aviplay for AVI previously opened with openavi. The first frame is shown when the first period is passed to aviplay
+unsigned int aviplay(unsigned int periods);
+// call often while playing, with the number of frame periods since the last call. Reads the next frame ahead a chunk at a
+// time while the current one is displayed, shows it when due, and skips frames if behind. returns avierrors index, 0 if OK
+void aviseek(unsigned int frame);
+// show frame next, found through the AVI index, as soon as aviplay has read it. Playing on from there needs periods as usual
 
 unsigned int loadbmp(char*, unsigned int);
 // read BMP file 0 : just get info, 1 : load into cambuffer 2 : load and display
@@ -183,15 +297,40 @@ unsigned int loadbmp(char*, unsigned int);
 unsigned int writebmpheader(unsigned int xsize, unsigned int ysize, unsigned int bpp);
 // write a BMP header (and pallette table for mono) to open file
 
-void flipcambuf(unsigned int xpixels, unsigned int ypixels, unsigned int offset);
-// vertical flip image in camera buffer for mono AVI. Also changes greyscale range to 16-240
+unsigned int writebmp(const frame_t* f);
+// write mono, RGB565 or RGB888 frame to open file as BMP, header and all. RGB565 is converted to 24 bit a sector at a time
+// through avibuf, leaving the frame unchanged. returns 0 if write failed
+
+unsigned int writeqoi(const frame_t* f);
+// write mono, RGB565 or RGB888 frame to open file as a QOI image ( lossless, usually under half the size of a BMP). Uses avibuf.
+// returns 0 if write failed
+
+unsigned int loadqoi(char* filename, unsigned int load);
+// read QOI file as loadbmp. Loads as RGB565, so up to cambufsize/2 pixels
 
-unsigned int startavi(void); // Start AVI write - just writes dummy header, only needs avi_bpp
-unsigned int finishavi(void); // write index and header
+unsigned int writeaviframe(const frame_t* f);
+// write frame as an AVI video chunk, in the line order and range the file needs. Uses avibuf for mono.
+// Contiguous RGB frames in BMP order need 8 free bytes before them for the chunk header, as ring frames have. returns 0 if write failed
+
+void flipcambuf(frame_t* f);
+// vertical flip frame in place, toggling img_revscan to match. Also changes greyscale range to 16-240 as for mono AVI.
+// Not needed before writeaviframe
+
+unsigned int jpeg_encode(const frame_t* f, unsigned int quality, unsigned char* buf, unsigned int buflen);
+// encode mono or RGB565 frame as a baseline JPEG ( greyscale or YCbCr 4:2:0), quality 1-100. returns length, 0 if it didn't fit in buflen
+
+unsigned int writemjpgframe(const frame_t* f, unsigned char* buf, unsigned int buflen);
+// write frame as an MJPG AVI video chunk at avi_quality, encoded in buf first. buflen half the raw frame size is plenty
+// at quality 75. Returns bytes written, 0 if write failed
+
+unsigned int startavi(void); // Start AVI write - just writes dummy header, only needs avi_bpp and avi_quality
+unsigned int finishavi(void); // write index and header. file must be open FS_WRITEPLUS for MJPG, as chunk lengths are read back for the index
 
 
 void cam_enable(unsigned int mode);
 // initialises or disables camera with parameters for specified mode. Does not start grabbing until grabenable used
+// cammode_off puts camera in warm standby so the next enable only takes a frame or two
+// cammode_powerdown does the same but forces a full reset on next enable
 
 void cam_grabdisable(void);
 // suspends grab process, camera stays initialised
@@ -199,10 +338,64 @@ void cam_grabdisable(void);
 void cam_grabenable(unsigned int opt, unsigned int bufoffset, unsigned int cambuflen);
 // starts acquisition. pptions in cambadge.h
 // first byte is garbage, so cam data will be at cambuffer[bufoffset+1]. See cambadge.h for modes
+
+void cam_grablayout(unsigned int opt, unsigned int bufoffset, unsigned int cambuflen);
+// the buffer side of cam_grabenable : wrap point, or ring slots. Only call with grab disabled
 //cambuflen sets value at which acquisition address will wrap to bufoffset, =0 for maximum. Can be used for FIFO acquisition of large frames
 
-void conv16_24(unsigned int npixels, unsigned int offset);
-// convert image at cambuffer[offset] from RGB565 to RGB888
+unsigned char* cam_acquire_frame(void);
+// ring mode : returns pointer to image data of oldest completed frame and marks it in use, or 0 if none ready
+// 8 bytes before the image data are free for use e.g. for AVI chunk header
+
+void cam_release_frame(unsigned char* frame);
+// ring mode : return frame previously got from cam_acquire_frame to the ring so it can be refilled
+
+void cam_frame(frame_t* f, unsigned char* p);
+// describe captured image data at p, e.g. from cam_acquire_frame, using the current mode's size and format
+
+void cam_linequeue(unsigned int step);
+// enable line queue, one entry queued every step lines and at end of frame. 0 to disable. Reset by cam_enable
+// for wrap mode ( cambuflen) use a wrap length that's a multiple of step lines so batches are contiguous
+
+unsigned char* cam_getline(unsigned int* line);
+// get next batch of captured lines from line queue. Returns pointer to image data of first line in batch, 0 if none waiting
+// *line set to line number of first line. Batch is step lines, or fewer at end of frame
+
+void cam_histenable(unsigned int step);
+// enable luminance histogram, sampling every step lines. 0 to disable. Reset by cam_enable
+// mono uses Y, RGB565 uses green. Capture uses per-line ISR rather than chained DMA while enabled
+
+unsigned short* cam_gethist(void);
+// returns pointer to histogram of last frame if a new one is ready since last call, 0 if not.
+// Valid until end of next frame
+
+unsigned int cam_histlevel(unsigned short* hist, unsigned int percent);
+// returns 0-255 level below which percent of histogram samples lie
+
+unsigned int cam_histmean(unsigned short* hist);
+// returns 0-255 mean level of histogram
+
+void cam_aec(unsigned int mode);
+// exposure control : 0 = sensor auto, 1 = locked, 2 = software AEC/AGC driven by cam_aecupdate
+
+unsigned int cam_aecupdate(unsigned short* hist, unsigned int target);
+// software AEC : adjust exposure and gain towards target 0-255 mean level. returns mean level
+
+void cam_autocontrast(unsigned short* hist, unsigned int lo, unsigned int hi);
+// set monopalette to stretch lo..hi percentiles of histogram to full range, smoothed over a few frames
+
+void conv16_24(frame_t* f);
+// convert RGB565 frame to RGB888 in place, lines packed together afterwards. Fails (leaves f as RGB565) if stride is over 3x width
+
+void conv16_24line(unsigned char* src, unsigned char* dest, unsigned int npixels);
+// convert RGB565 pixels at src to RGB888 at dest, e.g. one line at a time for streaming to file
+
+unsigned int sram_probe(void);
+// returns 1 if SPI SRAM fitted. sram_size bytes, shares SPI2 with the SD card so don't use while a file operation is in progress
+
+void sram_write(unsigned int addr, unsigned char* src, unsigned int len);
+void sram_read(unsigned int addr, unsigned char* dest, unsigned int len);
+// sequential access to SPI SRAM
 
 void claimadc(unsigned char claim); // call with 1 to claim use of ADC, disables battery read. Call with 0 to release
 
@@ -216,7 +409,7 @@ void claimadc(unsigned char claim); // call with 1 to claim use of ADC, disables
 //_____________________________________________________________ misc tables
 
 const char* avierrors[] = {"None", "Not found", "Read Err", "Not an AVI", "LIST Error", "Hdr Err", "Strm Err", "MOVI Err", "00dc Err", "Frame too big", "Unknown format", "Frame too wide", "Frame too tall",
-    "Not a BMP"};
+    "Not a BMP", "MJPG, play on PC", "Not a QOI"};
 
 // lookup for primary colors, and dim primaries
 #define dim 156
@@ -88,14 +88,47 @@ unsigned int iistart(unsigned char iiadr) {
 
 }
 
-void cam_setreg(unsigned char r, unsigned char d)
-//set camera register
+//___________________________________________________________ camera register shadow
+// RAM copy of camera registers, so unchanged values aren't re-sent and known registers can be read without I2C
+
+static unsigned char camshadow[256], camknown[256 / 8]; // register values, bitmap of which values are known
+
+unsigned int camregvolatile(unsigned char r) { // registers changed by the camera itself ( AEC/AGC/AWB) so can't be cached
+    switch (r) {
+        case 0x00: case 0x01: case 0x02: case 0x03: case 0x04: case 0x10: case 0x45: case 0xa1: // 0x04, 0x10 & 0xa1 hold AEC
+            return (1);
+    }
+    return (0);
+}
+
+void cam_shadowclear(void) { // forget all register values, e.g. after camera reset
+    unsigned int i;
+    for (i = 0; i != sizeof (camknown); camknown[i++] = 0);
+}
+
+void cam_writereg(unsigned char r, unsigned char d)
+//set camera register, always sent
 {
     I2C2BRG = clockfreq / 2 / i2cspeed_cam;
     iistart(iicadr_cam);
     iisend(r);
     iisend(d);
     iistop();
+    cam_i2ccount++;
+    if (camregvolatile(r)) return;
+    if ((r == 0x12) && (d & 0x80)) { // COM7 reset - everything back to unknown defaults
+        cam_shadowclear();
+        return;
+    }
+    camshadow[r] = d;
+    camknown[r >> 3] |= 1 << (r & 7);
+}
+
+void cam_setreg(unsigned char r, unsigned char d)
+//set camera register, only sent if different from last value written
+{
+    if (!camregvolatile(r)) if (camknown[r >> 3] & (1 << (r & 7))) if (camshadow[r] == d) return;
+    cam_writereg(r, d);
 }
 
 void acc_setreg(unsigned char r, unsigned char d)
@@ -108,14 +141,20 @@ void acc_setreg(unsigned char r, unsigned char d)
 }
 
 unsigned char readcamreg(unsigned char c) {
-    I2C2BRG = clockfreq / 2 / i2cspeed_cam;
     char d;
+    if (!camregvolatile(c)) if (camknown[c >> 3] & (1 << (c & 7))) return (camshadow[c]); // no need to ask the camera
+    I2C2BRG = clockfreq / 2 / i2cspeed_cam;
     iistart(iicadr_cam);
     iisend(c);
     iistop();
     iistart(iicadr_cam | 1);
     d = getiic(0);
     iistop();
+    cam_i2ccount++;
+    if (!camregvolatile(c)) {
+        camshadow[c] = d;
+        camknown[c >> 3] |= 1 << (c & 7);
+    }
     return (d);
 }
 
@@ -185,49 +224,200 @@ void cam_grabdisable(void) {
     cam_started = 0;
     IEC0CLR = _IEC0_INT4IE_MASK; // disable vsync int
     while (cam_busy); // wait for any in-progress grab to finish
+    camring = 0;
+    cam_slot = camslot_none;
 
 }
 
 void cam_grabenable(unsigned int opt, unsigned int bufoffset, unsigned int cambuflen) {// enable acquisition from running camera
 #define camtimeout 50 // mS
-    unsigned int i;
     cam_grabdisable();
-    cam_stop = (opt == camen_grab) ? 1 : 0;
-    camoffset = bufoffset;
-    cammax = cambuflen;
-    i=xpixels*((camflags&camopt_mono)?1:2);
-    if ((cammax == 0) || (cammax > cambufsize - i)) cammax = cambufsize - i; // add margin so we don't need to worry about line length
+    cam_grablayout(opt, bufoffset, cambuflen);
 
+    cam_lineqtail = cam_lineqhead; // discard any lines queued from previous grab
     IFS0CLR = _IFS0_INT4IF_MASK;
     IEC0SET = _IEC0_INT4IE_MASK; //enable vsync int
 
 }
 
+void cam_linequeue(unsigned int step) { // enable line queue, step lines per entry. 0 = off
+    cam_linestep = 0; // stop ISR queueing while we reset
+    cam_lineqtail = cam_lineqhead;
+    cam_lineqdrops = 0;
+    cam_linestep = step;
+}
+
+unsigned char* cam_getline(unsigned int* line) { // get next line batch from queue, 0 if none
+    unsigned int d;
+    if (cam_lineqtail == cam_lineqhead) return (0);
+    d = cam_lineq[cam_lineqtail & (camlineq_len - 1)];
+    cam_lineqtail++;
+    *line = d >> 16;
+    return (&cambuffer[(d & 0xffff) + 1]); // +1 as first byte is garbage due to PMP buffering
+}
+
+void cam_histenable(unsigned int step) { // enable luminance histogram every step lines. 0 = off
+    cam_histstep = step;
+    cam_histready = 0;
+}
+
+unsigned short* cam_gethist(void) { // histogram of last frame if new one ready, else 0
+    if (!cam_histready) return (0);
+    cam_histready = 0;
+    return ((unsigned short*) cam_hist);
+}
+
+unsigned int cam_histlevel(unsigned short* hist, unsigned int percent) { // 0-255 level below which percent of samples lie
+    unsigned int i, n, lim;
+    for (i = n = 0; i != camhist_bins; i++) n += hist[i];
+    lim = n * percent / 100;
+    n = 0;
+    for (i = 0; i != camhist_bins - 1; i++) {
+        n += hist[i];
+        if (n > lim) break;
+    }
+    return (i * (256 / camhist_bins) + (128 / camhist_bins));
+}
+
+unsigned int cam_histmean(unsigned short* hist) { // 0-255 mean level
+    unsigned int i, n, sum;
+    n = sum = 0;
+    for (i = 0; i != camhist_bins; i++) {
+        n += hist[i];
+        sum += hist[i] * i;
+    }
+    if (n == 0) return (0);
+    return (sum * (256 / camhist_bins) / n + (128 / camhist_bins));
+}
+
+static unsigned int aecexp, aecgain; // software AEC state : exposure in rows/4, gain in 1/16ths
+
+void cam_aecwrite(void) { // send software AEC exposure & gain to camera
+    unsigned int g, r, b;
+    cam_writereg(0x10, aecexp); // AEC[9:2]
+    cam_writereg(0xa1, aecexp >> 8 & 0x3f); // AEC[15:10]
+    g = aecgain; // gain = (G7+1)*(G6+1)*(G5+1)*(G4+1)*(1+G[3:0]/16)
+    r = 0;
+    for (b = 0x10; (g >= 32) && (b != 0x80); b <<= 1) {
+        r |= b;
+        g >>= 1;
+    }
+    cam_writereg(0x00, r | ((g - 16) & 15));
+}
+
+void cam_aec(unsigned int mode) { // 0 = sensor auto, 1 = locked, 2 = software
+    switch (mode) {
+        case 0: cam_setreg(0x13, 0xe7);
+            break;
+        case 1: cam_setreg(0x13, 0xe0);
+            break;
+        case 2:
+            cam_setreg(0x13, 0xe2); // AEC & AGC off, AWB on
+            aecexp = readcamreg(0x10) | (readcamreg(0xa1) & 0x3f) << 8; // carry on from where sensor AEC left off
+            if (aecexp == 0) aecexp = 1;
+            if (aecexp > camaec_expmax) aecexp = camaec_expmax;
+            aecgain = 16;
+            cam_aecwrite();
+    }
+}
+
+unsigned int cam_aecupdate(unsigned short* hist, unsigned int target) { // software AEC step, returns mean level
+    unsigned int mean, b, nb;
+    mean = cam_histmean(hist);
+    if ((mean + 8 > target) && (mean < target + 8)) return (mean); // dead band to avoid hunting
+    b = aecexp*aecgain; // total brightness
+    nb = b * target / (mean ? mean : 1);
+    nb = (b + nb) / 2; // only go halfway each frame as sensor lags a frame or two
+    if (nb < 16) nb = 16;
+    if (nb > camaec_expmax * camaec_gainmax) nb = camaec_expmax*camaec_gainmax;
+    // use exposure first, as gain adds noise
+    aecexp = nb / 16;
+    if (aecexp > camaec_expmax) aecexp = camaec_expmax;
+    aecgain = nb / aecexp;
+    if (aecgain < 16) aecgain = 16;
+    if (aecgain > camaec_gainmax) aecgain = camaec_gainmax;
+    cam_aecwrite();
+    return (mean);
+}
+
+void cam_autocontrast(unsigned short* hist, unsigned int lo, unsigned int hi) { // monopalette from histogram percentiles
+    static unsigned int palmin = 0, palmax = 255 * 4; // x4 for smoothing
+    unsigned int min, max;
+    min = cam_histlevel(hist, lo);
+    max = cam_histlevel(hist, hi);
+    palmin = (palmin * 3) / 4 + min;
+    palmax = (palmax * 3) / 4 + max;
+    min = palmin / 4;
+    max = palmax / 4;
+    if (max < min + 32) { // don't over-stretch flat images
+        max = (min + max) / 2 + 16;
+        if (max > 255) max = 255;
+        min = max - 32;
+    }
+    monopalette(min, max);
+}
+
+unsigned char* cam_acquire_frame(void) { // get oldest completed frame from ring, 0 if none ready
+    unsigned int i, s, seq;
+    s = camslot_none;
+    seq = 0;
+    for (i = 0; i != cam_nslots; i++)
+        if (cam_slotstate[i] == camslot_ready) if ((s == camslot_none) || ((int) (cam_slotseq[i] - seq) < 0)) {
+                s = i;
+                seq = cam_slotseq[i];
+            }
+    if (s == camslot_none) return (0);
+    cam_slotstate[s] = camslot_inuse;
+    return (&cambuffer[cam_slotaddr[s] + 1]); // +1 as first byte is garbage due to PMP buffering
+}
+
+void cam_release_frame(unsigned char* frame) { // give frame back to ring for re-use
+    unsigned int i;
+    for (i = 0; i != cam_nslots; i++)
+        if (&cambuffer[cam_slotaddr[i] + 1] == frame) cam_slotstate[i] = camslot_free;
+}
+
+void cam_frame(frame_t* f, unsigned char* p) { // describe captured frame at p
+    f->pixels = p;
+    f->width = xpixels;
+    f->height = ypixels;
+    f->format = ((camflags & camopt_mono) ? img_mono : img_rgb565) | img_revscan;
+    f->stride = xpixels * (f->format & 3);
+}
+
 void cam_enable(unsigned int mode) {//initialise & enable camera, Data will be at bufoffset+1 due to PMP buffering
     static unsigned int lastmode = 0;
-    unsigned int i, j;
+    unsigned int i, j, i2cstart;
 #include "camvals_9650.h"
+    static unsigned char colmatrix[sizeof (camvals_9650_mono) / 2]; // colour values of registers changed for mono, read after full init
 
     cam_grabdisable(); // stop any current grabbing
+    cam_linestep = 0; // line queue off until app asks for it
+    cam_histstep = 0; // histogram too
     REFOCON = 0b1001001000000000 | refclkdiv << 16; // fast while setting up regs - underclocking messes up I2C, causing bus jam
     T3CON = 0b1000000000000010; //external clock. PR values get set up in vertical sync int
 
     cammode = mode; // global current-mode value
-    if (cammode == 0) {//disable
-        cam_setreg(0x09, 0x10); // soft standby
+    if ((cammode == cammode_off) || (cammode == cammode_powerdown)) {//disable
+        cammode = cammode_off;
+        cam_setreg(0x09, 0x10); // soft standby. registers and exposure/AWB history are kept so next enable is quick
         // NB a second or so after doing hard powerdown, camera jams I2C SDA for a second or so as Vcore discharges,
         // causing I2C peripheral to hang. Only use hardware powerdown for soft 'off' mode, not routine cam enable/disable.
         //  oledcmd(0x1b5);oledcmd(0x0f); // cam hard powerdown ( uses OLED GPIO))
-        lastmode = 0; // ensure reinitialised next time
+        if (mode == cammode_powerdown) lastmode = 0; // ensure fully reinitialised next time
         return;
     }
 
     // enable
 
-    if (cammode >= ncammodes) cammode = 1;
-    i = camconfig[lastmode].flags;
+    if (lastmode) { // warm start from standby - check camera is still talking to us, full reset if not ( e.g. I2C jam)
+        i = iistart(iicadr_cam);
+        iistop();
+        if (i == 0) lastmode = 0;
+    }
+    if (cammode >= ncammodes_all) cammode = 1;
     camflags = camconfig[cammode].flags;
-    if ((i^camflags) & camopt_mono) lastmode = 0; // force full initialise if changing colour/mono
+    i2cstart = cam_i2ccount;
 
 
     xpixels = camconfig[cammode].xpixels;
@@ -237,7 +427,7 @@ void cam_enable(unsigned int mode) {//initialise & enable camera, Data will be a
     xstart = camconfig[cammode].xstart;
     ystart = camconfig[cammode].ystart;
 
-    if (lastmode == 0) { // only fully initialise if previously disabled, or changing mono/colour,for speed - cam takes a sec or two to stabilise after full reset
+    if (lastmode == 0) { // only fully initialise if previously disabled, for speed - cam takes a sec or two to stabilise after full reset
         lastmode = mode;
         // pulse camera powerdown to reset in case it's jamming the i2C bus - it sometimes does this if underclocked
         oledcmd(0x1b5);
@@ -246,24 +436,32 @@ void cam_enable(unsigned int mode) {//initialise & enable camera, Data will be a
         oledcmd(0x1b5);
         oledcmd(0x0C);
         delayus(10000);
+        cam_shadowclear();
         for (i = 0; i != sizeof (camvals_9650) / 2; i++) // /2 as array is 16 bit shorts
         {
             j = camvals_9650[i];
-            cam_setreg(j >> 8, j);
+            cam_writereg(j >> 8, j); // always send, as table repeats some registers deliberately
             if (i == 0) delayus(500); // initialise takes a while
         }
+        // remember colour matrix so mono/colour switch only needs to rewrite it, not fully re-initialise
+        for (i = 0; i != sizeof (camvals_9650_mono) / 2; i++) colmatrix[i] = readcamreg(camvals_9650_mono[i] >> 8);
     }
+    cam_setreg(0x09, 0x00); // out of standby
     i = (camflags & camopt_vga) ? 0x40 : 0x10;
+    if (camflags & camopt_sxga) i = 0x00;
     if (!(camflags & camopt_mono)) i |= 4;
     cam_setreg(0x12, i); // VGA mode
+    // window. SXGA values are sensor defaults, others as camvals_9650
+    cam_setreg(0x17, (camflags & camopt_sxga) ? 0x1d : 0x28); // HSTART
+    cam_setreg(0x18, (camflags & camopt_sxga) ? 0xbd : 0xc9); // HSTOP
+    cam_setreg(0x1a, (camflags & camopt_sxga) ? 0x81 : 0x6d); // VSTOP
     cam_setreg(0x3a, (camflags & camopt_swap) ? 0x08 : 0x00); // swap bytes
     cam_setreg(0x15, (camflags & camopt_clkphase) ? 0x22 : 0x32); // swap pixclk phase
-    if (camflags & camopt_mono) { // mono mode
-        for (i = 0; i != sizeof (camvals_9650_mono) / 2; i++) {
-            j = camvals_9650_mono[i];
-            cam_setreg(j >> 8, j);
-        }
-    }//mono
+    for (i = 0; i != sizeof (camvals_9650_mono) / 2; i++) { // mono or colour matrix - only changed values actually get sent
+        j = camvals_9650_mono[i];
+        cam_setreg(j >> 8, (camflags & camopt_mono) ? j : colmatrix[i]);
+    }
+    cam_switchi2c = cam_i2ccount - i2cstart;
 
 
     REFOCON = 0b1001001000000000 | ((((camflags >> 4)&7) + 2) << 16); // final clock rate after i2C done
@@ -308,6 +506,37 @@ unsigned int sendspi(unsigned int d) {
 
 }
 
+static void sram_cmd(unsigned int cmd, unsigned int addr) { // start SRAM read/write at addr. Sequential mode is power-up default
+    oled_wait(); // CS shared with OLED
+    sram_cs_lo;
+    sendspi(cmd);
+    sendspi(addr >> 16);
+    sendspi(addr >> 8);
+    sendspi(addr);
+}
+
+void sram_write(unsigned int addr, unsigned char* src, unsigned int len) {
+    sram_cmd(2, addr);
+    while (len--) sendspi(*src++);
+    sram_cs_hi;
+}
+
+void sram_read(unsigned int addr, unsigned char* dest, unsigned int len) {
+    sram_cmd(3, addr);
+    while (len--) *dest++ = sendspi(0);
+    sram_cs_hi;
+}
+
+unsigned int sram_probe(void) { // check SRAM fitted by writing & reading back a pattern at each end
+    unsigned char d[2] = {0x5a, 0xa5};
+    sram_write(0, &d[0], 1);
+    sram_write(sram_size - 1, &d[1], 1);
+    d[0] = d[1] = 0;
+    sram_read(0, &d[0], 1);
+    sram_read(sram_size - 1, &d[1], 1);
+    return ((d[0] == 0x5a) && (d[1] == 0xa5));
+}
+
 int randnum(int min, int max) { // return signed random number between ranges
     return (rand() % (max - min) + min);
 }
@@ -432,7 +661,7 @@ void inithardware(void) {// note hardware may not be in reset state as some stuf
 
     SPI1CON = 0; // may have been previously enabled by bootloader
     // fedcba9876543210
-    SPI1CON = 0b10000000100110000; // master, no Din, 8 bit
+    SPI1CON = 0b10000000100111100; // master, no Din, 8 bit, TX event when buffer not full to pace display DMA
     SPI1CON2 = 0;
     SPI1STAT = 0;
     SPI1BRG = (clockfreq / 2) / oledclk - 1;
@@ -509,6 +738,7 @@ void readbuttons(void) {
 
     // discovered that some SD cards have weak pullup on Din, need to fudge around this by reading but4 at right time -
     // slow enough for 2k2 switch pullup, but not so slow we catch the slower rise of the sd pullup
+    oled_wait(); // buttons share OLED control lines. Before interrupts go off, as an img_nowait transfer can take 20ms+ to finish
     __builtin_disable_interrupts();
    butts_in; // shared IOs to inputs
    butpress = butstate;
@@ -538,7 +768,7 @@ void readbuttons(void) {
 }
 
 void enterboot(void) { // enter bootloader by jumping to reset address
-    cam_enable(0);
+    cam_enable(cammode_powerdown);
     __builtin_disable_interrupts();
     void (*fptr)(void);
     fptr = (void (*)(void))(0xBFC00000);
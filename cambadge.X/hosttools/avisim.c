@@ -0,0 +1,348 @@
+// avisim - host model of AVI playback in the browser app : the read-then-display loop it used to have, against aviplay's read-ahead
+// Records raw AVIs with startavi/writeaviframe/finishavi into a RAM file, then plays each for a simulated 10 seconds from a
+// main loop that polls T2's frame period flag the way browser.c does, with card reads and display transfers taking
+// simulated time. Reports frames/s shown, frames dropped and how far playback has fallen behind the clock, and checks :
+// - every frame displayed is the frame avi_framenum says, complete
+// - aviplay never reads into the buffer the display DMA is sending
+// - aviplay keeps time, within a frame or two, and drops nothing when the card keeps up
+// Then seeking and files the badge doesn't write : AVIs rebuilt with JUNK, audio and LIST rec chunks between frames, empty
+// frames, file offsets in idx1, or no idx1 at all. These are played through with showavi and seeked around with aviseek,
+// checking the frame that comes up, and how much of the index each seek reads.
+// Card and display times are rough figures for the badge's 12MHz SPIs ( -c and -d to change them), so the results show
+// where the time goes rather than exact badge frame rates.
+//
+// build, from cambadge.X :
+//   gcc -std=gnu99 -O2 -Wall -Wextra -Ihosttools/sim -I. -o avisim hosttools/avisim.c hosttools/sim/hostsim.c fileformats.c globals.c -Wl,--allow-multiple-definition
+//
+// usage : avisim [-c us per KB read] [-d us per pixel displayed]
+//   exit status is 1 if anything fails
+
+#include "../cambadge.h"
+#include "../globals.h"
+#include "hostsim.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define maxframes 100
+#define simtime 10000000.0 // us of playback per test
+#define loopus 30.0 // rest of the main loop, per pass
+#define callus 150.0 // per card read call, FS overhead and sector command
+#define seekus 1500.0 // per seek, FS walking the cluster chain
+
+static double cardkb = 1200.0; // us per KB read, 12MHz SPI polled a byte at a time, and copied out of the sector buffer
+static double disppix = 1.4; // us per pixel displayed, 16 bits at 12MHz and a little
+static double now, dispend; // simulated time, when the display transfer in progress ends
+static unsigned char* dispimg; // image the display is sending
+static unsigned int displen, fails, idxbytes; // idxbytes counts index reads, into the top of avibuf
+static unsigned char textline[dispwidth * 2];
+
+// the RAM file and display stand-ins are hostsim.c's. Card reads and seeks take simulated time, through its hooks,
+// and the display ones here replace its do-nothing ones
+
+static void readhook(void* p, size_t len) {
+    if (oled_busy && ((unsigned char*) p < dispimg + displen) && ((unsigned char*) p + len > dispimg)) {
+        printf("read into the image being displayed\n");
+        fails++;
+    }
+    if ((unsigned char*) p >= avibuf + hbuflen / 2 && (unsigned char*) p < avibuf + hbuflen) idxbytes += len;
+    now += callus + len * cardkb / 1024;
+}
+
+static void seekhook(void) {
+    now += seekus;
+}
+
+void oled_wait(void) {
+    if (oled_busy && (dispend > now)) now = dispend;
+    oled_busy = 0;
+}
+
+static void checkframe(unsigned char* img, unsigned int npix) {
+    // test frames are one value all over, from the frame number
+    unsigned int i, want;
+    want = (avi_bpp == 1) ? 16 + avi_framenum * 2 * 223 / 255 : avi_framenum; // mono is range-limited in the file
+    for (i = 0; i != npix; i++)
+        if (((avi_bpp == 1) ? img[i] : (unsigned int) (img[i * 2] | img[i * 2 + 1] << 8)) != want) break;
+    if (i != npix) {
+        printf("frame %d shown with pixel %d wrong\n", avi_framenum, i);
+        fails++;
+    }
+}
+
+void dispimage(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format, unsigned char* imgaddr) {
+    (void) xstart, (void) ystart;
+    oled_wait();
+    if (imgaddr != textline) checkframe(imgaddr, xsize * ysize);
+    dispimg = imgaddr;
+    displen = xsize * ysize * (format & 3);
+    dispend = now + xsize * ysize * disppix;
+    oled_busy = 1;
+    if (!(format & img_nowait)) oled_wait();
+}
+
+void dispscaled(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format, unsigned char* imgaddr,
+        unsigned int srcw, unsigned int srch, unsigned int stride) {
+    (void) xstart, (void) ystart, (void) xsize, (void) ysize, (void) format, (void) imgaddr, (void) srcw, (void) srch, (void) stride;
+    printf("test frames shouldn't need scaling\n");
+    fails++;
+}
+
+static unsigned char src[128 * 128 * 2 + 8];
+
+static void makeavi(unsigned int bpp, unsigned int w, unsigned int h, unsigned int frametime) {
+    frame_t f;
+    unsigned int i, j;
+    avi_bpp = bpp;
+    avi_width = w;
+    avi_height = h;
+    avi_framelen = w * h * bpp;
+    avi_frametime = frametime;
+    avi_quality = 0;
+    fptr = FSfopen("x.avi", FS_WRITEPLUS);
+    startavi();
+    for (avi_frames = 0; avi_frames != maxframes; avi_frames++) {
+        for (j = 0; j != w * h; j++)
+            if (bpp == 1) src[8 + j] = avi_frames * 2;
+            else src[8 + j * 2] = avi_frames, src[8 + j * 2 + 1] = 0;
+        f.pixels = src + 8; // room for writeaviframe's chunk header in front
+        f.width = w;
+        f.height = h;
+        f.stride = w * bpp;
+        f.format = (bpp == 1) ? img_mono : img_rgb565;
+        writeaviframe(&f);
+    }
+    finishavi();
+    i = openavi("x.avi");
+    if (i) printf("openavi returned %d\n", i), fails++;
+}
+
+static void text(void) {
+    // the info line, as printf would draw it
+    dispimage(0, 0, dispwidth, charheight, img_rgb565, textline);
+}
+
+static unsigned int oldshowavi(void) {
+    // browser playback as it was : read a frame, then display it and wait. Frames back to back
+    if (++avi_framenum == avi_frames) {
+        FSfseek(fptr, avi_start, SEEK_SET);
+        avi_framenum = 0;
+    }
+    if (FSfread(cambuffer, avi_framelen + 8, 1, fptr) == 0) return (2);
+    dispimage(0, 0, avi_width, avi_height, avi_bpp | ((avi_bpp > 1) ? img_revscan : 0), cambuffer);
+    return (0);
+}
+
+static unsigned int play(unsigned int readahead, unsigned int* shown, unsigned int* dropped) {
+    // play for simtime as browser.c does, returns how many frames behind the clock playback ended up
+    unsigned int i, j, periods, t2flag, infodue, behind;
+    double t2next;
+    now = dispend = 0;
+    oled_busy = 0;
+    periods = infodue = 0;
+    t2next = avi_frametime;
+    t2flag = 1; // force first
+    if (readahead) aviplay_start();
+    else {
+        *shown = *dropped = 0;
+        avi_framenum = avi_frames - 1;
+        FSfseek(fptr, avi_start, SEEK_SET);
+    }
+    while (now < simtime) {
+        now += loopus;
+        if (now >= dispend) oled_busy = 0; // DMA done int
+        while (now >= t2next) {
+            t2flag = 1;
+            t2next += avi_frametime;
+            periods++;
+        }
+        if (readahead) {
+            i = t2flag;
+            t2flag = 0;
+            j = avi_shown;
+            if (aviplay(i)) {
+                printf("aviplay error\n");
+                fails++;
+                break;
+            }
+            if (avi_shown != j) infodue = 1;
+            if (infodue && !oled_busy) {
+                text();
+                infodue = 0;
+            }
+        } else if (t2flag) {
+            t2flag = 0;
+            if (oldshowavi()) {
+                printf("read error\n");
+                fails++;
+                break;
+            }
+            (*shown)++;
+            text();
+        }
+    }
+    if (readahead) {
+        *shown = avi_shown;
+        *dropped = avi_dropped;
+    }
+    i = *shown + *dropped; // frames played through, shown or not
+    behind = (periods + 1 > i) ? periods + 1 - i : 0; // first frame is at time 0
+    return (behind);
+}
+
+static void test(const char* name, unsigned int bpp, unsigned int w, unsigned int h, unsigned int fps) {
+    unsigned int s0, d0, b0, s1, d1, b1, f0, two;
+    double t;
+    f0 = fails;
+    makeavi(bpp, w, h, 1000000 / fps);
+    t = avi_framelen * cardkb / 1024 + (avi_framelen / avi_readchunk + 1) * callus; // card time per frame
+    two = ((avi_framelen + 1 + 8 + 3) & ~3) * 2 <= cambufsize; // as aviplay_start
+    b0 = play(0, &s0, &d0);
+    b1 = play(1, &s1, &d1);
+    printf("%-14s %2dfps  old %5.1ffps %4d behind   aviplay %5.1ffps %4d dropped %2d behind  %d buffer%s\n", name, fps,
+            s0 * 1e6 / simtime, b0, s1 * 1e6 / simtime, d1, b1, two ? 2 : 1, two ? "s" : "");
+    // can be mid-way through a frame that takes a few periods to read and show when the time's up
+    if (b1 > 2 + (avi_framelen * cardkb / 1024 + w * h * disppix) / avi_frametime) printf("%s : aviplay fell behind\n", name), fails++;
+    if (d1 && (t < avi_frametime * 0.8) && (w * h * disppix < avi_frametime * 0.8) && (two || (t + w * h * disppix < avi_frametime * 0.8)))
+        printf("%s : aviplay dropped frames with time to spare\n", name), fails++; // with one buffer, reading waits for the display
+    if (fails != f0) printf("%s FAILED\n", name);
+}
+
+static unsigned char mix[(128 * 128 * 2 + 8) * maxframes + 65536]; // AVI being rebuilt
+static unsigned int mixidx[maxframes * 4][4], nidx; // its idx1 entries
+
+static void put32(unsigned char* p, unsigned int v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static unsigned int chunk(unsigned int pos, const char* id, const unsigned char* data, unsigned int len, unsigned int base) {
+    // put a chunk in mix[] at pos, padded to even, and an index entry unless base is ~0. returns where the next goes
+    memcpy(mix + pos, id, 4);
+    put32(mix + pos + 4, len);
+    if (data) memcpy(mix + pos + 8, data, len);
+    else memset(mix + pos + 8, 0x55, len);
+    if (len & 1) mix[pos + 8 + len] = 0;
+    if (base != ~0u) {
+        memcpy(&mixidx[nidx][0], id, 4);
+        mixidx[nidx][1] = 0x10;
+        mixidx[nidx][2] = pos - base;
+        mixidx[nidx++][3] = len;
+    }
+    return (pos + 8 + len + (len & 1));
+}
+
+static void makemixed(unsigned int absolute) {
+    // rebuild the AVI openavi last opened with other chunks round the frames, as PC tools write them :
+    // JUNK before the movi LIST and between frames, audio, frames in LIST rec, and every 11th frame empty
+    unsigned int k, pos, list, movi, rec, base, frame;
+    nidx = 0;
+    pos = avi_start - 8 - 12; // movi LIST
+    memcpy(mix, sim_file, pos);
+    pos = chunk(pos, "JUNK", NULL, 37, ~0);
+    list = pos;
+    memcpy(mix + pos, "LIST\0\0\0\0movi", 12);
+    movi = pos + 8;
+    pos += 12;
+    base = absolute ? 0 : movi;
+    for (k = 0; k != avi_frames; k++) {
+        frame = avi_start + k * (avi_framelen + 8);
+        if (k % 3 == 1) pos = chunk(pos, "JUNK", NULL, 1 + k % 20, ~0);
+        rec = 0;
+        if (k % 5 == 2) { // audio and video together in a LIST rec
+            rec = pos;
+            memcpy(mix + pos, "LIST\0\0\0\0rec ", 12);
+            memcpy(&mixidx[nidx][0], "rec ", 4);
+            mixidx[nidx][1] = 0;
+            mixidx[nidx++][2] = pos - base;
+            pos += 12;
+        }
+        if ((k % 2 == 0) || rec) pos = chunk(pos, "01wb", NULL, 100 + k * 7 % 301, base);
+        pos = chunk(pos, "00dc", sim_file + frame, (k % 11 == 5) ? 0 : avi_framelen, base);
+        if (rec) {
+            put32(mix + rec + 4, pos - rec - 8);
+            mixidx[nidx - 3][3] = pos - rec - 8;
+        }
+    }
+    put32(mix + list + 4, pos - list - 8);
+    memcpy(mix + pos, "idx1", 4);
+    put32(mix + pos + 4, nidx * 16);
+    memcpy(mix + pos + 8, mixidx, nidx * 16);
+    pos += 8 + nidx * 16;
+    put32(mix + 4, pos - 8);
+    memcpy(sim_file, mix, pos);
+    sim_filelen = pos;
+}
+
+static void seektest(const char* name, unsigned int how) {
+    // play through twice with showavi, as the splash screen does, then seek about with aviseek, and play in time
+    // how is 0 for the file as recorded, 1 rebuilt with other chunks, 2 the same with file offsets in idx1, 3 no idx1
+    unsigned int i, k, n, target, nframes, maxidx, f0, s, d, b;
+    f0 = fails;
+    makeavi(2, 64, 48, 1000000 / 30);
+    nframes = avi_frames;
+    if (how == 3) { // lose idx1
+        sim_filelen = avi_start + nframes * (avi_framelen + 8) - 8;
+        put32(sim_file + 4, sim_filelen - 8);
+    }
+    if ((how == 1) || (how == 2)) makemixed(how == 2);
+    idxbytes = 0;
+    i = openavi("x.avi");
+    if (i || (avi_frames != nframes) || (avi_framelen != 64 * 48 * 2)) printf("%s : openavi returned %d, %d frames of %d bytes\n", name, i, avi_frames, avi_framelen), fails++;
+    printf("%-26s %6d bytes, %4d bytes of index read at open", name, sim_filelen, idxbytes);
+    now = 0;
+    aviplay_start();
+    for (k = 0; (k != nframes * 2) && (fails == f0); k++) {
+        if (showavi() || (avi_framenum != k % nframes)) printf("\n%s : showavi gave frame %d, not %d", name, avi_framenum, k % nframes), fails++;
+    }
+
+    srand(2);
+    for (k = maxidx = 0; (k != 300) && (fails == f0); k++) {
+        target = (k < 3) ? k * (nframes - 1) / 2 : (k & 1) ? (target + 1) % nframes : rand() % nframes; // ends, steps, anywhere
+        idxbytes = 0;
+        n = avi_shown;
+        aviseek(target);
+        do i = aviplay(0);
+        while ((i == 0) && (avi_shown == n));
+        if (i || (avi_framenum != target)) printf("\n%s : seek to frame %d gave %d, error %d", name, target, avi_framenum, i), fails++;
+        if (idxbytes > maxidx) maxidx = idxbytes;
+    }
+    printf(", %4d per seek at most\n", maxidx);
+    if ((how == 0) && (maxidx > 16)) printf("%s : seeks read more than one index entry\n", name), fails++;
+    if ((how == 3) && maxidx) printf("%s : index read with no index\n", name), fails++;
+
+    b = play(1, &s, &d);
+    if (b > 2) printf("%s : fell %d frames behind playing at 30fps\n", name, b), fails++;
+    if (fails != f0) printf("%s FAILED\n", name);
+}
+
+int main(int argc, char** argv) {
+    unsigned int i;
+    for (i = 1; i < (unsigned int) argc; i++) {
+        if (!strcmp(argv[i], "-c") && (i + 1 < (unsigned int) argc)) cardkb = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && (i + 1 < (unsigned int) argc)) disppix = atof(argv[++i]);
+        else {
+            printf("usage : avisim [-c us per KB read] [-d us per pixel displayed]\n");
+            return (2);
+        }
+    }
+    sim_readhook = readhook;
+    sim_seekhook = seekhook;
+    printf("card %.0fus/KB, display %.2fus/pixel\n", cardkb, disppix);
+    fails = 0;
+    test("RGB565 128x96", 2, 128, 96, 15);
+    test("RGB565 128x96", 2, 128, 96, 25);
+    test("RGB565 128x96", 2, 128, 96, 30);
+    test("mono 128x96", 1, 128, 96, 25);
+    test("mono 128x128", 1, 128, 128, 30);
+    test("RGB565 128x128", 2, 128, 128, 15);
+    test("RGB565 128x128", 2, 128, 128, 25);
+    test("RGB565 64x48", 2, 64, 48, 30);
+    seektest("as recorded", 0);
+    seektest("JUNK, audio, LIST rec", 1);
+    seektest("as above, file offsets", 2);
+    seektest("no idx1", 3);
+    printf("%d failed\n", fails);
+    return (fails ? 1 : 0);
+}
@@ -0,0 +1,517 @@
+// capsim - host-side camera capture simulator
+// Runs the real vsint/hsint/dmaint/dma1int code from interrupts.c against a model of the PMP, Timer 3 and
+// DMA channels 0 & 1, fed by a synthetic or recorded sensor byte stream with vsync/hsync timing, and checks
+// the frames, lines and histograms that come out. Lets capture changes be regression-tested and compared
+// ( ISR entries per frame) without a badge.
+//
+// build, from cambadge.X :
+//   gcc -std=gnu99 -O2 -Wall -Wextra -Ihosttools/sim -I. -o capsim hosttools/capsim.c interrupts.c globals.c -Wl,--allow-multiple-definition
+// ( camconfig is defined in cambadge.h, so every object has a copy)
+//
+// usage : capsim [-s scenario] [-n frames] [-r rawfile] [-v]
+//   runs all scenarios by default. exit status is 1 if any fail
+//   -r uses raw sensor bytes from file instead of the test pattern : frames of 240, 480 or 1024 rows of
+//      640, 1280 or 2560 bytes ( QVGA, VGA, SXGA), in PCLK order as seen on the PMP bus. Wraps round at end of file
+//
+// Model
+//  - only active rows are clocked, as COM10 gates PCLK outside HREF. hsync int is at the end of each row
+//  - Timer 3 counts PCLK, and triggers a DMA0 cell each time it matches PR3
+//  - PMP reads return the byte latched by the previous read, and latch the byte on the bus now.
+//    Second read of a 2-byte cell sees the next PCLK's byte
+//  - DMA block is max(SSIZ,DSIZ) bytes. Pointers reset at block end, on re-enable, or if DSA changes
+//  - a channel's IRQ event is the rising edge of (DCHxINT flags & enables), which also sets the IFS bit
+//  - ISRs run to completion at the point their flag and enable are both set, highest priority first.
+//    So ISR latency isn't modelled - lines are assumed to be long enough for the ISRs to keep up
+//  - INT1IF is left set by the last row of each frame, so hsint runs straight after vsint and
+//    image line y comes from sensor row ystart + y*ydiv
+//
+// Image byte k of a line is sensor byte 2*xstart + xdiv*(k/cell+1) + k%cell, cell = DMA cell size
+// The last byte of each line except the last gets overwritten by the next line's PMP garbage byte,
+// which is the sample 2 on from the one that should be there. This is reported separately, not as an error.
+
+#include "../cambadge.h"
+#include "../globals.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void vsint(void); // ISRs in interrupts.c
+void hsint(void);
+void dmaint(void);
+void dma1int(void);
+extern unsigned int camlinetab[camlinetab_len];
+
+//_________________________________________________________________ SFRs
+
+volatile sim_dchcon sim_dch0con, sim_dch1con;
+volatile unsigned int DMACON, DCH0ECON, DCH0INT, DCH0SSA, DCH0DSA, DCH0SSIZ, DCH0DSIZ, DCH0CSIZ;
+volatile unsigned int DCH1ECON, DCH1INT, DCH1SSA, DCH1DSA, DCH1SSIZ, DCH1DSIZ, DCH1CSIZ;
+volatile unsigned int IFS0, IFS1, IEC0, IEC1, INTCON, PR3, TMR3, PMDIN, LATC, U2RXREG;
+volatile unsigned long TMR4;
+volatile sim_iecbits IEC0bits, IEC1bits;
+volatile sim_ifsbits IFS0bits, IFS1bits;
+volatile sim_ipcbits IPC1bits, IPC4bits, IPC9bits, IPC10bits;
+volatile sim_intconbits INTCONbits;
+volatile sim_uxstabits U2STAbits;
+unsigned int sim_coretimer;
+
+void oled_dmanext(void) { // display DMA isn't modelled
+}
+
+#define wrlog_len 64
+static struct {
+    volatile unsigned int* reg;
+    unsigned int op;
+    unsigned int val;
+} wrlog[wrlog_len];
+static unsigned int wrlogn;
+
+void sim_flush(void) { // apply SET/CLR/INV writes in the order the code did them
+    unsigned int i;
+    for (i = 0; i != wrlogn; i++) switch (wrlog[i].op) {
+            case sim_op_set: *wrlog[i].reg |= wrlog[i].val;
+                break;
+            case sim_op_clr: *wrlog[i].reg &= ~wrlog[i].val;
+                break;
+            case sim_op_inv: *wrlog[i].reg ^= wrlog[i].val;
+        }
+    wrlogn = 0;
+}
+
+volatile unsigned int* sim_wr(volatile unsigned int* reg, unsigned int op) {
+    if (wrlogn == wrlog_len) sim_flush(); // all earlier values have been written by now
+    wrlog[wrlogn].reg = reg;
+    wrlog[wrlogn].op = op;
+    wrlog[wrlogn].val = 0;
+    return (&wrlog[wrlogn++].val);
+}
+
+//_________________________________________________________________ physical address map
+// made-up addresses, just distinct ranges so stray pointers show up
+
+#define pa_ram 0x00000000 // cambuffer
+#define pa_linetab 0x00100000 // camlinetab
+#define pa_pmdin 0x1f807040
+#define pa_dch0dsa 0x1f883090
+#define pa_bad 0xffffffff
+
+static unsigned int strays, unmapped; // DMA accesses outside known memory, unknown pointers given to KVA_TO_PA
+
+unsigned int sim_pa(const volatile void* p) {
+    const volatile unsigned char* b = p;
+    if ((b >= cambuffer) && (b <= cambuffer + cambufsize)) return (pa_ram + (b - cambuffer));
+    if ((b >= (unsigned char*) camlinetab) && (b <= (unsigned char*) (camlinetab + camlinetab_len)))
+        return (pa_linetab + (b - (unsigned char*) camlinetab));
+    if (p == &PMDIN) return (pa_pmdin);
+    if (p == &DCH0DSA) return (pa_dch0dsa);
+    unmapped++;
+    return (pa_bad);
+}
+
+//_________________________________________________________________ sensor stream
+
+static unsigned int rows, rowlen; // sensor geometry for current mode
+static unsigned char* rawdata; // recorded stream, 0 for test pattern
+static unsigned long rawlen;
+
+static unsigned int sensorbyte(unsigned int f, unsigned int r, unsigned int c) {
+    if ((r >= rows) || (c >= rowlen)) return (0); // bus idle outside active area
+    if (rawdata) return (rawdata[((unsigned long) f * rows * rowlen + r * rowlen + c) % rawlen]);
+    return ((r * 31 + c * 7 + f * 13) & 0xff); // odd steps so row, column or frame slips all show
+}
+
+static unsigned char rowbuf[2560 + 4];
+static unsigned int pmplatch, pmpidx; // PMP read latch, bus position of next PMP read
+
+static unsigned int pmp_read(void) { // DMA read of PMDIN
+    unsigned int d = pmplatch;
+    pmplatch = rowbuf[pmpidx++];
+    return (d);
+}
+
+//_________________________________________________________________ DMA
+
+typedef struct {
+    volatile unsigned int *con, *econ, *intr, *ssa, *dsa, *ssiz, *dsiz, *csiz;
+    unsigned int irq, ifsmask; // IRQ number and IFS1 bit of this channel's interrupt
+    unsigned int on, sptr, dptr, count, lastdsa;
+} dmachan;
+
+static dmachan dch[2] = {
+    {&DCH0CON, &DCH0ECON, &DCH0INT, &DCH0SSA, &DCH0DSA, &DCH0SSIZ, &DCH0DSIZ, &DCH0CSIZ, 60, _IFS1_DMA0IF_MASK, 0, 0, 0, 0, 0},
+    {&DCH1CON, &DCH1ECON, &DCH1INT, &DCH1SSA, &DCH1DSA, &DCH1SSIZ, &DCH1DSIZ, &DCH1CSIZ, 61, _IFS1_DMA1IF_MASK, 0, 0, 0, 0, 0}
+};
+
+static unsigned int dma_read(unsigned int pa) {
+    if (pa == pa_pmdin) return (pmp_read());
+    if ((pa >= pa_linetab) && (pa < pa_linetab + sizeof (camlinetab))) return (((unsigned char*) camlinetab)[pa - pa_linetab]);
+    if (pa < pa_ram + cambufsize) return (cambuffer[pa - pa_ram]);
+    strays++;
+    return (0);
+}
+
+static void dma_write(unsigned int pa, unsigned int d) {
+    if (pa < pa_ram + cambufsize) cambuffer[pa - pa_ram] = d;
+    else if ((pa >= pa_dch0dsa) && (pa < pa_dch0dsa + 4)) {
+        pa = (pa - pa_dch0dsa)*8;
+        DCH0DSA = (DCH0DSA & ~(0xff << pa)) | d << pa;
+    } else strays++;
+}
+
+static void dma_irqevent(unsigned int irq);
+
+static void dma_cell(dmachan* c) { // one cell transfer, in response to start IRQ
+    unsigned int i, n, block, irqwas;
+    if (!(*c->con & 0x80)) {
+        c->on = 0;
+        return;
+    }
+    if ((!c->on) || (*c->dsa != c->lastdsa)) c->sptr = c->dptr = c->count = 0;
+    c->on = 1;
+    c->lastdsa = *c->dsa;
+    irqwas = (*c->intr >> 16) & *c->intr & 0xff;
+    block = (*c->ssiz > *c->dsiz) ? *c->ssiz : *c->dsiz;
+    n = *c->csiz;
+    for (i = 0; i != n; i++) {
+        dma_write(*c->dsa + c->dptr, dma_read(*c->ssa + c->sptr));
+        if (++c->sptr == *c->ssiz) c->sptr = 0;
+        if (++c->dptr == *c->dsiz) {
+            c->dptr = 0;
+            *c->intr |= 1 << 5; // CHDDIF
+        }
+        if (++c->count == block) { // block done, channel disables
+            c->count = c->sptr = c->dptr = 0;
+            *c->intr |= 1 << 3; // CHBCIF
+            *c->con &= ~0x80;
+            c->on = 0;
+            break;
+        }
+    }
+    *c->intr |= 1 << 2; // CHCCIF
+    c->lastdsa = *c->dsa; // may have been changed by this transfer
+    if (!irqwas && ((*c->intr >> 16) & *c->intr & 0xff)) {
+        IFS1 |= c->ifsmask;
+        dma_irqevent(c->irq);
+    }
+}
+
+static void dma_irqevent(unsigned int irq) { // start any channels triggered by this IRQ
+    unsigned int i;
+    for (i = 0; i != 2; i++)
+        if ((*dch[i].econ & 1 << 4) && ((*dch[i].econ >> 8 & 0xff) == irq)) dma_cell(&dch[i]);
+}
+
+//_________________________________________________________________ interrupt dispatch
+
+#define isr_vs 0
+#define isr_hs 1
+#define isr_dma 2
+#define isr_dma1 3
+static const char* isrnames[4] = {"vsint", "hsint", "dmaint", "dma1int"};
+static unsigned long isrcalls[4], isrns[4];
+static unsigned int isrstorm;
+
+static void callisr(void (*isr)(void), unsigned int n) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    isr();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    sim_flush();
+    isrcalls[n]++;
+    isrns[n] += (t1.tv_sec - t0.tv_sec)*1000000000L + t1.tv_nsec - t0.tv_nsec;
+}
+
+static void dispatch(void) { // run pending ISRs, highest priority first
+    unsigned int i;
+    sim_flush();
+    for (i = 0; i != 16; i++) {
+        if (IFS0 & IEC0 & _IFS0_INT4IF_MASK) callisr(vsint, isr_vs);
+        else if (IFS0 & IEC0 & _IFS0_INT1IF_MASK) callisr(hsint, isr_hs);
+        else if (IFS1 & IEC1 & _IFS1_DMA0IF_MASK) callisr(dmaint, isr_dma);
+        else if (IFS1 & IEC1 & _IFS1_DMA1IF_MASK) callisr(dma1int, isr_dma1);
+        else return;
+    }
+    isrstorm++; // ISR not clearing its flag
+}
+
+//_________________________________________________________________ foreground side
+
+// as cam_grabenable in hardware.c, which can't be built here. The buffer layout is interrupts.c's own cam_grablayout
+static void sim_grabenable(unsigned int opt, unsigned int bufoffset, unsigned int cambuflen) {
+    IEC0 &= ~_IEC0_INT4IE_MASK;
+    cam_newframe = 0;
+    cam_started = 0;
+    cam_slot = camslot_none;
+    cam_grablayout(opt, bufoffset, cambuflen);
+    cam_lineqtail = cam_lineqhead;
+    IFS0 &= ~_IFS0_INT4IF_MASK;
+    IEC0 |= _IEC0_INT4IE_MASK;
+}
+
+static unsigned int linebytes_fg(void) {
+    return ((camflags & camopt_mono) ? xpixels : xpixels * 2);
+}
+
+static unsigned int expected(unsigned int f, unsigned int y, unsigned int k) { // sensor byte that should be at image byte k of line y
+    unsigned int cell = (camflags & camopt_double) ? 2 : 1;
+    return (sensorbyte(f, ystart + y * ydiv, 2 * xstart + xdiv * (k / cell + 1) + k % cell));
+}
+
+static unsigned int pixerrs, edgediffs, verbose;
+
+static void checkline(unsigned char* p, unsigned int f, unsigned int y, unsigned int edge) {
+    // edge = 1 if last byte may have been overwritten by next line's garbage byte
+    unsigned int k, n;
+    n = linebytes_fg();
+    for (k = 0; k != n; k++) if (p[k] != expected(f, y, k)) {
+            if (edge && (k == n - 1)) {
+                edgediffs++;
+                continue;
+            }
+            if (verbose && (pixerrs < 10)) printf("  frame %d line %d byte %d : %02X expected %02X\n", f, y, k, p[k], expected(f, y, k));
+            pixerrs++;
+        }
+}
+
+static void checkframe(unsigned char* p, unsigned int f) { // contiguous frame
+    unsigned int y;
+    for (y = 0; y != ypixels; y++) checkline(p + y * linebytes_fg(), f, y, y != ypixels - 1);
+}
+
+static unsigned int histerrs;
+
+static void checkhist(unsigned int f) { // cam_hist against histogram of the sampled sensor bytes
+    unsigned short h[camhist_bins];
+    unsigned int y, k, d, n;
+    memset(h, 0, sizeof (h));
+    n = linebytes_fg();
+    for (y = 0; y < ypixels; y += cam_histstep)
+        if (camflags & camopt_mono) for (k = 0; k < n; k += camhist_xstep) h[expected(f, y, k) >> 2]++;
+        else for (k = 0; k < n; k += camhist_xstep * 2) {
+                d = expected(f, y, k) | expected(f, y, k + 1) << 8;
+                h[d >> 5 & 0x3f]++;
+            }
+    if (memcmp(h, (void*) cam_hist, sizeof (h))) {
+        if (verbose) printf("  frame %d histogram mismatch\n", f);
+        histerrs++;
+    }
+}
+
+//_________________________________________________________________ scenarios
+
+typedef struct {
+    const char* name;
+    unsigned int mode; // camconfig index
+    unsigned int opt; // camen_xxx
+    unsigned int offset, buflen; // as cam_grabenable
+    unsigned int linestep, histstep;
+    unsigned int hold; // ring : frames the foreground keeps each frame before release
+    int xadj, yadj; // added to xpixels/ypixels, to force overflows
+    unsigned int expectframes; // =1 if every frame ( less ring drops) should arrive, 0 if none should
+} scenario;
+
+static const scenario scenarios[] = {
+    {"qvga rgb", 1, camen_start, 7, 0, 0, 0, 0, 0, 0, 1},
+    {"vga rgb", 2, camen_start, 7, 0, 0, 0, 0, 0, 0, 1},
+    {"qvga mono", 3, camen_start, 7, 0, 0, 0, 0, 0, 0, 1},
+    {"qvga mono x2", 4, camen_start, 7, 0, 0, 0, 0, 0, 0, 1},
+    {"vga mono x4", 5, camen_start, 7, 0, 0, 0, 0, 0, 0, 1},
+    {"single grabs", 3, camen_grab, 7, 0, 0, 0, 0, 0, 0, 1},
+    {"line queue", 1, camen_start, 7, 0, 4, 0, 0, 0, 0, 1},
+    {"histogram mono", 4, camen_start, 7, 0, 0, 2, 0, 0, 0, 1},
+    {"histogram rgb", 1, camen_start, 7, 0, 0, 3, 0, 0, 0, 1},
+    {"ring", 4, camen_ring, 7, 128 * 96 + 8, 0, 0, 1, 0, 0, 1},
+    {"ring slow fg", 1, camen_ring, 7, 128 * 96 * 2 + 8, 0, 0, 3, 0, 0, 1},
+    {"burst, frames held", 4, camen_ring, 7, 128 * 96 + 8, 0, 0, 1000, 0, 0, 1},
+    {"wrap fifo", 3, camen_start, 7, 7 + 128 * 24, 8, 0, 0, 0, 0, 1},
+    {"too many lines", 4, camen_start, 7, 0, 0, 0, 0, 0, 200, 0},
+    {"line too long", 4, camen_start, 7, 0, 0, 0, 0, 200, 0, 0},
+    {"line too long, short frame", 3, camen_start, 7, 0, 0, 0, 0, 100, -60, 0},
+    {"line too long, per-line int", 4, camen_start, 7, 0, 4, 0, 0, 200, 0, 0},
+    {"vga mono still fifo", cammode_vga_mono, camen_grab, 7, 7 + 632 * 76, 4, 0, 0, 0, 0, 1},
+    {"vga rgb still fifo", cammode_vga_rgb, camen_grab, 7, 7 + 632 * 76, 4, 0, 0, 0, 0, 1},
+    {"sxga mono still fifo", cammode_sxga_mono, camen_grab, 7, 7 + 1272 * 36, 4, 0, 0, 0, 0, 1},
+};
+#define nscenarios (sizeof(scenarios)/sizeof(scenarios[0]))
+
+static unsigned int slotcounts(void) {
+    // ring slots that fit for the camera app's AVI, MJPG and burst rings at 128x96, as camera.c asks for them
+    static const struct {
+        const char* name;
+        unsigned int mode, offset, buflen, minslots;
+    } t[] = {
+        {"rgb", 1, 7, 128 * 96 * 2 + 8, 2},
+        {"mono", 4, 7, 128 * 96 + 8, 4},
+        {"mjpg rgb", 1, 128 * 96 + 7, 128 * 96 * 2 + 8, 1},
+        {"mjpg mono", 4, 128 * 96 / 2 + 7, 128 * 96 + 8, 3},
+    };
+    unsigned int i, ok, fails;
+    fails = 0;
+    for (i = 0; i != sizeof (t) / sizeof (t[0]); i++) {
+        camflags = camconfig[t[i].mode].flags;
+        xpixels = camconfig[t[i].mode].xpixels;
+        ypixels = camconfig[t[i].mode].ypixels;
+        cam_grablayout(camen_ring, t[i].offset, t[i].buflen);
+        ok = (cam_nslots >= t[i].minslots) && (cam_slotaddr[cam_nslots - 1] + t[i].buflen + 2 <= cambufsize); // and the last one's overrun fits
+        printf("ring slots, 128x96 %-10s %s  %d slots\n", t[i].name, ok ? "pass" : "FAIL", cam_nslots);
+        fails += !ok;
+    }
+    return (fails);
+}
+
+static unsigned int runscenario(const scenario* s, unsigned int nframes) {
+    unsigned int f, r, c, n, t, line, gotframes, missed, ok;
+    unsigned int slotframe[camring_maxslots], heldslot[8], heldage[8], nheld, i;
+    unsigned char* p;
+
+    camflags = camconfig[s->mode].flags;
+    xpixels = camconfig[s->mode].xpixels + s->xadj;
+    ypixels = camconfig[s->mode].ypixels + s->yadj;
+    xdiv = camconfig[s->mode].xdiv;
+    ydiv = camconfig[s->mode].ydiv;
+    xstart = camconfig[s->mode].xstart;
+    ystart = camconfig[s->mode].ystart;
+    rows = (camflags & camopt_sxga) ? 1024 : (camflags & camopt_vga) ? 480 : 240;
+    rowlen = (camflags & camopt_sxga) ? 2560 : (camflags & camopt_vga) ? 1280 : 640;
+
+    memset(cambuffer, 0, cambufsize);
+    memset(isrcalls, 0, sizeof (isrcalls));
+    memset(isrns, 0, sizeof (isrns));
+    DCH0CON = DCH1CON = DCH1INT = IEC0 = IEC1 = IFS1 = 0;
+    DCH0INT = 1 << 21; // as setupints
+    IFS0 = _IFS0_INT1IF_MASK; // sensor already running, so hsync flag is set
+    dch[0].on = dch[1].on = 0;
+    strays = unmapped = pixerrs = edgediffs = histerrs = isrstorm = 0;
+    gotframes = missed = nheld = 0;
+    cam_linestep = s->linestep;
+    cam_lineqdrops = cam_drops = 0;
+    cam_histstep = s->histstep;
+    cam_histready = 0;
+    sim_grabenable(s->opt, s->offset, s->buflen);
+
+    for (f = 0; f != nframes; f++) {
+        IFS0 |= _IFS0_INT4IF_MASK; // vsync
+        dispatch();
+        if (camring && (cam_slot != camslot_none)) slotframe[cam_slot] = f;
+
+        for (r = 0; r != rows; r++) {
+            for (c = 0; c != rowlen; c++) rowbuf[c] = sensorbyte(f, r, c);
+            for (c = 0; c != rowlen; c++) {
+                t = TMR3 & 0xffff;
+                if (t == PR3) {
+                    TMR3 = 0;
+                    pmpidx = c;
+                    dma_irqevent(14); // Timer 3
+                    dispatch();
+                } else TMR3 = (t + 1) & 0xffff;
+
+                if (cam_linestep) { // foreground takes lines as they're queued
+                    while (cam_lineqtail != cam_lineqhead) {
+                        n = cam_lineq[cam_lineqtail & (camlineq_len - 1)];
+                        cam_lineqtail++;
+                        p = &cambuffer[(n & 0xffff) + 1];
+                        line = n >> 16;
+                        for (i = 0; (i != cam_linestep) && (line + i < ypixels); i++)
+                            checkline(p + i * linebytes_fg(), f, line + i, (i != cam_linestep - 1) && (line + i != ypixels - 1));
+                    }
+                }
+            }
+            IFS0 |= _IFS0_INT1IF_MASK; // hsync at end of row
+            dispatch();
+        }
+
+        // foreground, end of frame
+        if (camring) {
+            for (i = 0; i != nheld; i++) if (++heldage[i] >= s->hold) {
+                    cam_slotstate[heldslot[i]] = camslot_free;
+                    heldslot[i] = heldslot[--nheld];
+                    heldage[i--] = heldage[nheld];
+                }
+            while (1) { // take all ready frames, oldest first, as cam_acquire_frame
+                unsigned int sl = camslot_none, seq = 0;
+                for (i = 0; i != cam_nslots; i++)
+                    if (cam_slotstate[i] == camslot_ready) if ((sl == camslot_none) || ((int) (cam_slotseq[i] - seq) < 0)) {
+                            sl = i;
+                            seq = cam_slotseq[i];
+                        }
+                if (sl == camslot_none) break;
+                checkframe(&cambuffer[cam_slotaddr[sl] + 1], slotframe[sl]);
+                gotframes++;
+                if (s->hold == 0) cam_slotstate[sl] = camslot_free;
+                else {
+                    cam_slotstate[sl] = camslot_inuse;
+                    heldslot[nheld] = sl;
+                    heldage[nheld++] = 0;
+                }
+            }
+        } else if (cam_newframe) {
+            cam_newframe = 0;
+            if (!cam_linestep && (cammax - camoffset >= ypixels * linebytes_fg())) checkframe(&cambuffer[camoffset + 1], f);
+            gotframes++;
+            if (cam_histstep) {
+                if (cam_histready) checkhist(f);
+                else histerrs++;
+                cam_histready = 0;
+            }
+            if (s->opt == camen_grab) sim_grabenable(camen_grab, s->offset, s->buflen);
+        } else missed++;
+    }
+
+    ok = (pixerrs == 0) && (histerrs == 0) && (strays == 0) && (unmapped == 0) && (isrstorm == 0);
+    if (s->expectframes) ok = ok && (gotframes + cam_drops == nframes) && (gotframes != 0);
+    else ok = ok && (gotframes == 0);
+
+    printf("%-28s %s  frames %3d/%-3d", s->name, ok ? "pass" : "FAIL", gotframes, nframes);
+    if (camring) printf(" drops %d", cam_drops);
+    if (cam_linestep) printf(" lineq drops %d", cam_lineqdrops);
+    if (pixerrs) printf(" pixel errors %d", pixerrs);
+    if (histerrs) printf(" histogram errors %d", histerrs);
+    if (strays) printf(" stray DMA %d", strays);
+    if (unmapped) printf(" bad KVA_TO_PA %d", unmapped);
+    if (isrstorm) printf(" ISR flag stuck");
+    printf("\n    ISR entries/frame :");
+    for (i = 0; i != 4; i++) printf(" %s %lu", isrnames[i], isrcalls[i] / nframes);
+    printf("  host ns/frame %lu", (isrns[0] + isrns[1] + isrns[2] + isrns[3]) / nframes);
+    if (edgediffs) printf("  line-end garbage bytes %d", edgediffs);
+    printf("\n");
+    return (ok);
+}
+
+int main(int argc, char** argv) {
+    unsigned int i, fails, nframes, only;
+    FILE* fp;
+    nframes = 8;
+    only = 0;
+    for (i = 1; i < (unsigned int) argc; i++) {
+        if (!strcmp(argv[i], "-v")) verbose = 1;
+        else if (!strcmp(argv[i], "-s") && (i + 1 < (unsigned int) argc)) only = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && (i + 1 < (unsigned int) argc)) nframes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && (i + 1 < (unsigned int) argc)) {
+            fp = fopen(argv[++i], "rb");
+            if (!fp) {
+                printf("can't open %s\n", argv[i]);
+                return (2);
+            }
+            fseek(fp, 0, SEEK_END);
+            rawlen = ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+            rawdata = malloc(rawlen ? rawlen : 1);
+            if ((rawlen == 0) || (fread(rawdata, 1, rawlen, fp) != rawlen)) {
+                printf("can't read %s\n", argv[i]);
+                return (2);
+            }
+            fclose(fp);
+        } else {
+            printf("usage : capsim [-s scenario] [-n frames] [-r rawfile] [-v]\n");
+            for (i = 0; i != nscenarios; i++) printf("  %2d %s\n", i + 1, scenarios[i].name);
+            return (2);
+        }
+    }
+    if (nframes == 0) nframes = 1;
+
+    fails = only ? 0 : slotcounts();
+    for (i = 0; i != nscenarios; i++)
+        if ((only == 0) || (only == i + 1)) fails += !runscenario(&scenarios[i], nframes);
+    printf("%d failed\n", fails);
+    return (fails ? 1 : 0);
+}
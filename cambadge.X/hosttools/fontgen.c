@@ -0,0 +1,90 @@
+// fontgen - makes the larger badge fonts from font6x8.inc
+// Each size step is Scale2x ( EPX) on the glyph bitmap, which doubles it and rounds off diagonals instead of
+// leaving stair-steps, so the big fonts keep the look of the 6x8 one without hand-drawing.
+//
+// build & run, from cambadge.X :
+//   gcc -std=gnu99 -O2 -o fontgen hosttools/fontgen.c && ./fontgen
+// writes font12x16.inc ( all 6x8 glyphs) and fontnum24x32.inc ( '+' .. ':' only, for readouts)
+//
+// Output format is that of font_t in globals.h : (width+7)/8 bytes per row, MSB leftmost, top row first,
+// height rows per glyph, glyphs in character order
+
+#include <stdio.h>
+#include <string.h>
+
+#pragma GCC diagnostic ignored "-Wmissing-braces" // FONT6x8's initialiser is one flat list
+#include "../font6x8.inc"
+
+#define maxw 32
+#define maxh 32
+
+typedef struct {
+    int w, h;
+    unsigned char p[maxh][maxw];
+} glyph;
+
+static void scale2x(glyph* d, const glyph* s) {
+    int x, y, a, b, c, e, p;
+    d->w = s->w * 2;
+    d->h = s->h * 2;
+    for (y = 0; y != s->h; y++)
+        for (x = 0; x != s->w; x++) { // off the edge is background, as glyphs are surrounded by it
+            p = s->p[y][x];
+            a = y ? s->p[y - 1][x] : 0; // up
+            b = (x + 1 != s->w) ? s->p[y][x + 1] : 0; // right
+            c = x ? s->p[y][x - 1] : 0; // left
+            e = (y + 1 != s->h) ? s->p[y + 1][x] : 0; // down
+            d->p[y * 2][x * 2] = ((c == a) && (c != e) && (a != b)) ? a : p;
+            d->p[y * 2][x * 2 + 1] = ((a == b) && (a != c) && (b != e)) ? b : p;
+            d->p[y * 2 + 1][x * 2] = ((e == c) && (e != b) && (c != a)) ? c : p;
+            d->p[y * 2 + 1][x * 2 + 1] = ((b == e) && (b != a) && (e != c)) ? e : p;
+        }
+}
+
+static void load(glyph* g, int c) {
+    int x, y;
+    g->w = 6;
+    g->h = 8;
+    for (y = 0; y != 8; y++)
+        for (x = 0; x != 6; x++) g->p[y][x] = (FONT6x8[c - startchar][y] >> (7 - x)) & 1;
+}
+
+static int write(const char* fname, const char* name, int first, int count, int steps) {
+    FILE* f;
+    glyph g, t;
+    int c, i, x, y, b, bpr;
+
+    f = fopen(fname, "w");
+    if (f == NULL) {
+        perror(fname);
+        return 1;
+    }
+    load(&g, first);
+    for (i = 0; i != steps; i++) scale2x(&t, &g), g = t;
+    bpr = (g.w + 7) / 8;
+    fprintf(f, "// %dx%d font, characters 0x%02x..0x%02x. Made by hosttools/fontgen.c from font6x8.inc, don't edit\r\n\r\n", g.w, g.h, first, first + count - 1);
+    fprintf(f, "const unsigned char %s[%d * %d * %d] = {\r\n", name, count, g.h, bpr);
+    for (c = first; c != first + count; c++) {
+        load(&g, c);
+        for (i = 0; i != steps; i++) scale2x(&t, &g), g = t;
+        for (y = 0; y != g.h; y++) {
+            fprintf(f, "   ");
+            for (b = 0; b != bpr; b++) {
+                for (i = x = 0; x != 8; x++) i = i << 1 | ((b * 8 + x < g.w) ? g.p[y][b * 8 + x] : 0);
+                fprintf(f, " 0x%02x,", i);
+            }
+            fprintf(f, " // ");
+            for (x = 0; x != g.w; x++) fputc(g.p[y][x] ? '#' : '.', f);
+            if (y == 0) fprintf(f, ((c >= 32) && (c < 127)) ? "  '%c'" : "  %d", c);
+            fprintf(f, "\r\n");
+        }
+    }
+    fprintf(f, "};\r\n");
+    fclose(f);
+    return 0;
+}
+
+int main(void) {
+    if (write("font12x16.inc", "FONT12x16", startchar, nchars_6x8, 1)) return 1;
+    return write("fontnum24x32.inc", "FONTNUM24x32", '+', ':' - '+' + 1, 2);
+}
@@ -0,0 +1,298 @@
+// mjpegbench - host build of the MJPG AVI writer in fileformats.c, for speed and correctness checks without a badge
+// - checks the flash Huffman code tables against the DHT tables they're written out as
+// - encodes moving test frames with jpeg_encode at a range of qualities and reports frames/s, bytes per frame
+//   and PSNR after decoding with libjpeg. libjpeg's own encoder ( same tables, islow DCT, 4:2:0) is the reference for
+//   size and PSNR - the test scene has per-channel noise, so 4:2:0 PSNR is low for both
+// - records AVIs through startavi/writemjpgframe/finishavi ( and writeaviframe, to check the uncompressed path
+//   still comes out the same) to a RAM file, then walks the RIFF structure and idx1, decoding every indexed chunk
+//
+// build, from cambadge.X ( needs libjpeg, e.g. libjpeg-turbo dev package) :
+//   gcc -std=gnu99 -O2 -Wall -Wextra -Ihosttools/sim -I. -o mjpegbench hosttools/mjpegbench.c hosttools/sim/hostsim.c globals.c -ljpeg -lm -Wl,--allow-multiple-definition
+// fileformats.c is #included, so its static tables can be checked
+//
+// usage : mjpegbench [-n frames] [-o file.avi]
+//   -o keeps the last colour MJPG AVI written, to try in a PC player. exit status is 1 if anything fails
+//
+// Host frames/s is only for comparing encoder changes - nothing here times the PIC32.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <jpeglib.h> // before the badge headers, as it uses "version" as a parameter name
+#undef TRUE // GenericTypeDefs.h has these as an enum
+#undef FALSE
+
+#include "../fileformats.c"
+#include "hostsim.h"
+
+#define fw 128 // test frame size, as the camera app records
+#define fh 96
+
+static unsigned char src[fw * fh * 2 + 8]; // +8 for writeaviframe's chunk header
+static unsigned char rgb[fw * fh * 3]; // the test frame as 8 bit RGB ( or Y), for comparing with the decoded one
+static unsigned char out[fw * fh * 3];
+static unsigned char jbuf[fw * fh * 2];
+
+static void makeframe(frame_t* f, unsigned int format, unsigned int n) {
+    // frame n of the shared moving test scene, with a little noise, so there's something for every coefficient
+    static unsigned char scene[fw * fh * 3];
+    unsigned int x, y, r, g, b, v, i, line;
+    sim_scene(scene, fw, fh, n, 8);
+    for (y = 0; y != fh; y++)
+        for (x = 0; x != fw; x++) {
+            i = (y * fw + x) * 3;
+            r = scene[i];
+            g = scene[i + 1];
+            b = scene[i + 2];
+            line = (format & img_revscan) ? fh - 1 - y : y;
+            if ((format & 3) == img_mono) {
+                v = (r * 77 + g * 150 + b * 29) >> 8;
+                src[8 + line * fw + x] = v;
+                rgb[y * fw + x] = v;
+            } else {
+                v = rgbto16(r, g, b);
+                src[8 + (line * fw + x) * 2] = v;
+                src[8 + (line * fw + x) * 2 + 1] = v >> 8;
+                rgb[i] = (v >> 8) & 0xf8; // as the encoder expands RGB565
+                rgb[i] |= rgb[i] >> 5;
+                rgb[i + 1] = (v >> 3) & 0xfc;
+                rgb[i + 1] |= rgb[i + 1] >> 6;
+                rgb[i + 2] = (v << 3) & 0xf8;
+                rgb[i + 2] |= rgb[i + 2] >> 5;
+            }
+        }
+    f->pixels = src + 8;
+    f->width = fw;
+    f->height = fh;
+    f->stride = fw * (format & 3);
+    f->format = format;
+}
+
+static double decode(const unsigned char* jpg, unsigned int len, unsigned int ncomp) {
+    // decode with libjpeg, return PSNR against rgb[], or 0 if it isn't a fw x fh image with ncomp components
+    struct jpeg_decompress_struct d;
+    struct jpeg_error_mgr e;
+    JSAMPROW row;
+    unsigned int i, n;
+    double err, v;
+
+    d.err = jpeg_std_error(&e);
+    jpeg_create_decompress(&d);
+    jpeg_mem_src(&d, (unsigned char*) jpg, len);
+    if ((jpeg_read_header(&d, 1) != JPEG_HEADER_OK) || (d.image_width != fw) || (d.image_height != fh) || (d.num_components != (int) ncomp)) {
+        jpeg_destroy_decompress(&d);
+        return (0);
+    }
+    jpeg_start_decompress(&d);
+    while (d.output_scanline < d.output_height) {
+        row = out + d.output_scanline * fw * ncomp;
+        jpeg_read_scanlines(&d, &row, 1);
+    }
+    jpeg_finish_decompress(&d);
+    n = e.num_warnings;
+    jpeg_destroy_decompress(&d);
+    if (n) return (0); // corrupt data gets a warning, not an error
+    for (i = 0, err = 0; i != fw * fh * ncomp; i++) {
+        v = (double) out[i] - rgb[i];
+        err += v * v;
+    }
+    err /= fw * fh * ncomp;
+    return ((err == 0) ? 99 : 10 * log10(255.0 * 255.0 / err));
+}
+
+static double refencode(unsigned int format, unsigned int quality, unsigned int* len) {
+    // encode rgb[] with libjpeg at the same settings, return PSNR when decoded and length
+    struct jpeg_compress_struct c;
+    struct jpeg_error_mgr e;
+    JSAMPROW row;
+    unsigned char* mem = NULL;
+    unsigned long size = 0;
+    double psnr;
+
+    c.err = jpeg_std_error(&e);
+    jpeg_create_compress(&c);
+    jpeg_mem_dest(&c, &mem, &size);
+    c.image_width = fw;
+    c.image_height = fh;
+    c.input_components = ((format & 3) == img_mono) ? 1 : 3;
+    c.in_color_space = ((format & 3) == img_mono) ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&c);
+    jpeg_set_quality(&c, quality, 1);
+    c.dct_method = JDCT_ISLOW;
+    jpeg_start_compress(&c, 1);
+    while (c.next_scanline < fh) {
+        row = rgb + c.next_scanline * fw * c.input_components;
+        jpeg_write_scanlines(&c, &row, 1);
+    }
+    jpeg_finish_compress(&c);
+    jpeg_destroy_compress(&c);
+    psnr = decode(mem, size, ((format & 3) == img_mono) ? 1 : 3);
+    *len = size;
+    free(mem);
+    return (psnr);
+}
+
+static unsigned int checktables(void) {
+    // the symbol-indexed code tables must be what the DHT tables decode to ( JPEG Annex C)
+    const unsigned char* dht[4] = {jpeg_dht_dclum, jpeg_dht_dcchr, jpeg_dht_aclum, jpeg_dht_acchr};
+    const unsigned int* tab[4] = {jpeg_dclum, jpeg_dcchr, jpeg_aclum, jpeg_acchr};
+    const unsigned int tablen[4] = {12, 12, 256, 256};
+    unsigned int t[256];
+    unsigned int i, j, k, len, code, fails;
+    fails = 0;
+    for (i = 0; i != 4; i++) {
+        memset(t, 0, sizeof (t));
+        for (len = 1, code = 0, k = 16; len <= 16; len++, code <<= 1)
+            for (j = 0; j != dht[i][len - 1]; j++) t[dht[i][k++]] = len << 16 | code++;
+        if (memcmp(t, tab[i], tablen[i] * 4)) {
+            printf("Huffman table %d doesn't match its DHT table\n", i);
+            fails++;
+        }
+    }
+    return (fails);
+}
+
+static unsigned int bench(unsigned int format, unsigned int quality, unsigned int nframes) {
+    frame_t f;
+    struct timespec t0, t1;
+    unsigned int i, len, total, reflen, reftotal;
+    double t, psnr, refpsnr, worst;
+    total = reftotal = 0;
+    worst = 99;
+    t = 0;
+    for (i = 0; i != nframes; i++) {
+        makeframe(&f, format, i);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        len = jpeg_encode(&f, quality, jbuf, sizeof (jbuf));
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        t += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        psnr = len ? decode(jbuf, len, ((format & 3) == img_mono) ? 1 : 3) : 0;
+        refpsnr = refencode(format, quality, &reflen);
+        if (psnr - refpsnr < worst) worst = psnr - refpsnr;
+        total += len;
+        reftotal += reflen;
+    }
+    len = fw * fh * (format & 3);
+    printf("%-6s q%3d %6.0f fps %5d bytes/frame ( raw %d, %4.1fx smaller) libjpeg %5d, PSNR vs libjpeg %+5.2fdB worst\n",
+            ((format & 3) == img_mono) ? "mono" : "RGB565", quality, nframes / t, total / nframes, len, (double) len * nframes / total,
+            reftotal / nframes, worst);
+    return ((worst < -0.5) || (total > reftotal + reftotal / 20)); // within rounding of libjpeg
+}
+
+static unsigned int getword(const unsigned char* p) {
+    return (p[0] | p[1] << 8 | p[2] << 16 | (unsigned int) p[3] << 24);
+}
+
+static unsigned int checkavi(const char* name, unsigned int format, unsigned int quality, unsigned int nframes, unsigned int buflen) {
+    // record an AVI the way the camera app does, into the RAM file, then check it
+    unsigned char* a;
+    frame_t f;
+    unsigned int i, len, movi, idx, ofs, size, fails, hdrlen;
+    double psnr;
+
+    avi_bpp = format & 3;
+    avi_width = fw;
+    avi_height = fh;
+    avi_framelen = quality ? 0 : fw * fh * avi_bpp;
+    avi_frames = 0;
+    avi_frametime = 66666;
+    avi_quality = quality;
+    fptr = FSfopen(name, FS_WRITEPLUS);
+    if ((fptr == NULL) || startavi()) {
+        printf("%s : can't start\n", name);
+        return (1);
+    }
+    for (i = 0; i != nframes; i++) {
+        makeframe(&f, format, i);
+        if ((quality ? writemjpgframe(&f, jbuf, buflen) : writeaviframe(&f)) == 0) {
+            printf("%s : frame %d write failed\n", name, i);
+            return (1);
+        }
+        avi_frames++;
+    }
+    if (finishavi()) {
+        printf("%s : finishavi failed\n", name);
+        return (1);
+    }
+
+    fails = 0;
+    a = sim_file;
+    size = sim_filelen;
+#define avifail(...) do { printf("%s : ", name); printf(__VA_ARGS__); printf("\n"); fails++; } while (0)
+    hdrlen = ((avi_bpp == 2) && !quality) ? 0xec : 0xe0;
+    if (memcmp(a, "RIFF", 4) || (getword(a + 4) != size - 8) || memcmp(a + 8, "AVI ", 4)) avifail("RIFF header wrong");
+    if (getword(a + 0x10) != hdrlen - 0x20) avifail("hdrl length %x", getword(a + 0x10));
+    if (memcmp(a + 0x6c, "vids", 4) || (quality && memcmp(a + 0x70, "MJPG", 4))) avifail("strh type/handler wrong");
+    if (quality && (memcmp(a + 0xbc, "MJPG", 4) || (a[0xba] != 24))) avifail("strf compression/bits wrong");
+    movi = hdrlen - 4;
+    if (memcmp(a + movi - 8, "LIST", 4) || memcmp(a + movi, "movi", 4)) avifail("movi LIST not where expected");
+    idx = movi + getword(a + movi - 4);
+    if ((idx + 8 > size) || memcmp(a + idx, "idx1", 4) || (getword(a + idx + 4) != nframes * 16) || (idx + 8 + nframes * 16 != size))
+        avifail("idx1 not at end of movi, or wrong length");
+    if (fails) return (fails);
+    ofs = 0;
+    for (i = 0; i != nframes; i++) {
+        ofs = movi + getword(a + idx + 8 + i * 16 + 8);
+        len = getword(a + idx + 8 + i * 16 + 12);
+        if (memcmp(a + ofs, "00dc", 4) || (getword(a + ofs + 4) != len) || (ofs + 8 + len > idx)) {
+            avifail("frame %d index entry doesn't match its chunk", i);
+            break;
+        }
+        if (quality && (ofs & 1)) avifail("frame %d chunk not word aligned", i);
+        makeframe(&f, format, i);
+        if (quality == 0) {
+            if (len != fw * fh * avi_bpp) avifail("frame %d raw length %d", i, len);
+            continue;
+        }
+        psnr = decode(a + ofs + 8, len, (avi_bpp == 1) ? 1 : 3);
+        if (psnr < 18) avifail("frame %d decodes badly, PSNR %.1f", i, psnr); // q10 still manages 20 on the test scene
+    }
+    if (fails == 0) { // last chunk ends at idx1, allowing for the pad byte
+        len = ofs + 8 + len;
+        if ((len + (quality ? len & 1 : 0)) != idx) avifail("gap after last chunk");
+    }
+    i = openavi((char*) name); // the badge's own player
+    FSfclose(fptr);
+    if (i != (quality ? 14 : 0)) avifail("openavi returned %d", i);
+    if ((quality == 0) && ((avi_frames != nframes) || (avi_width != fw) || (avi_height != fh) || (avi_bpp != (format & 3))))
+        avifail("openavi read back wrong parameters");
+    printf("%-22s %3d frames %7d bytes %s\n", name, nframes, size, fails ? "FAIL" : "ok");
+    return (fails);
+}
+
+int main(int argc, char** argv) {
+    unsigned int i, nframes, fails;
+    const unsigned int q[] = {30, 50, 75, 90};
+    const char* keep = NULL;
+    FILE* fp;
+    nframes = 50;
+    for (i = 1; i < (unsigned int) argc; i++) {
+        if (!strcmp(argv[i], "-n") && (i + 1 < (unsigned int) argc)) nframes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && (i + 1 < (unsigned int) argc)) keep = argv[++i];
+        else {
+            printf("usage : mjpegbench [-n frames] [-o file.avi]\n");
+            return (2);
+        }
+    }
+    if (nframes < 2) nframes = 2;
+
+    fails = checktables();
+    for (i = 0; i != sizeof (q) / sizeof (q[0]); i++) fails += bench(img_rgb565, q[i], nframes);
+    for (i = 0; i != sizeof (q) / sizeof (q[0]); i++) fails += bench(img_mono, q[i], nframes);
+
+    fails += checkavi("mjpg_rgb.avi", img_rgb565, mjpg_quality, nframes, fw * fh);
+    if (keep && ((fp = fopen(keep, "wb")) != NULL)) {
+        fwrite(sim_file, 1, sim_filelen, fp);
+        fclose(fp);
+    }
+    fails += checkavi("mjpg_rgb_rev.avi", img_rgb565 | img_revscan, mjpg_quality, nframes, fw * fh);
+    fails += checkavi("mjpg_mono.avi", img_mono, mjpg_quality, nframes, fw * fh / 2);
+    fails += checkavi("mjpg_small.avi", img_rgb565, 95, nframes, 2000); // too small for q95, so quality gets stepped down
+    fails += checkavi("raw_rgb.avi", img_rgb565, 0, nframes, 0);
+    fails += checkavi("raw_mono.avi", img_mono, 0, nframes, 0);
+
+    printf("%d failed\n", fails);
+    return (fails ? 1 : 0);
+}
@@ -0,0 +1,251 @@
+// qoibench - host build of the QOI still writer and loader in fileformats.c, compared with BMP
+// For mono and RGB565 test frames, clean and with camera-like noise :
+// - times writeqoi and writebmp, and compares sizes. For RGB565 also times conv16_24 then writebmp, as BMPs were
+//   saved before writebmp took RGB565, and checks the two files are the same byte for byte
+// - loads the QOI back with loadqoi and checks every pixel, and decodes it again with a separate decoder
+//   written straight from the spec, as a check that the files are real QOI and not just self-consistent
+// Also checks revscan, RGB888 and cropped ( stride > width) frames, and loadqoi's error returns.
+//
+// build, from cambadge.X :
+//   gcc -std=gnu99 -O2 -Wall -Wextra -Ihosttools/sim -I. -o qoibench hosttools/qoibench.c hosttools/sim/hostsim.c fileformats.c globals.c -Wl,--allow-multiple-definition
+//
+// usage : qoibench [-n repeats]
+//   exit status is 1 if anything fails. Files are kept in RAM, so MB/s is encoding only, of source frame bytes
+
+#include "../cambadge.h"
+#include "../globals.h"
+#include "hostsim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define fw 128 // test frame size, as the camera app saves
+#define fh 96
+
+static unsigned char src[fw * fh * 3]; // test frame, as the camera leaves it
+static unsigned char work[fw * fh * 3]; // copy for conv16_24 to convert in place
+static unsigned char bmp[fw * fh * 3 + 2048]; // BMP as writebmp wrote it from RGB565
+static unsigned short want[fw * fh]; // what loadqoi should give for each pixel, top down
+static unsigned char ref[fw * fh * 4]; // reference decoder output, RGBA
+
+static void makeframe(frame_t* f, unsigned int format, unsigned int noise) {
+    // the shared test scene, still, optionally with the +-3 or so noise a camera frame has
+    static unsigned char rgb[fw * fh * 3];
+    unsigned int x, y, r, g, b, v, line;
+    sim_scene(rgb, fw, fh, 20, noise ? 7 : 0);
+    for (y = 0; y != fh; y++)
+        for (x = 0; x != fw; x++) {
+            r = rgb[(y * fw + x) * 3];
+            g = rgb[(y * fw + x) * 3 + 1];
+            b = rgb[(y * fw + x) * 3 + 2];
+            line = (format & img_revscan) ? fh - 1 - y : y;
+            switch (format & 3) {
+                case img_mono:
+                    v = (r * 77 + g * 150 + b * 29) >> 8;
+                    src[line * fw + x] = v;
+                    want[y * fw + x] = rgbto16(v, v, v);
+                    break;
+                case img_rgb565:
+                    v = rgbto16(r, g, b);
+                    src[(line * fw + x) * 2] = v;
+                    src[(line * fw + x) * 2 + 1] = v >> 8;
+                    want[y * fw + x] = v;
+                    break;
+                default:
+                    src[(line * fw + x) * 3] = b;
+                    src[(line * fw + x) * 3 + 1] = g;
+                    src[(line * fw + x) * 3 + 2] = r;
+                    want[y * fw + x] = rgbto16(r, g, b);
+            }
+        }
+    f->pixels = src;
+    f->width = fw;
+    f->height = fh;
+    f->stride = fw * (format & 3);
+    f->format = format;
+}
+
+static unsigned int refdecode(const unsigned char* q, unsigned int len, unsigned int* w, unsigned int* h) {
+    // QOI decoder after the reference one, RGBA bytes into ref[]. returns 0 if the file is malformed
+    unsigned char index[64][4], px[4];
+    unsigned int i, p, run, b1, b2, n;
+    int vg;
+    if ((len < 22) || memcmp(q, "qoif", 4)) return (0);
+    *w = q[4] << 24 | q[5] << 16 | q[6] << 8 | q[7];
+    *h = q[8] << 24 | q[9] << 16 | q[10] << 8 | q[11];
+    if ((*w * *h > fw * fh) || (q[12] != 3) || memcmp(q + len - 8, "\0\0\0\0\0\0\0\1", 8)) return (0);
+    memset(index, 0, sizeof (index));
+    px[0] = px[1] = px[2] = 0;
+    px[3] = 255;
+    p = 14;
+    run = 0;
+    for (n = 0; n != *w * *h; n++) {
+        if (run) run--;
+        else if (p < len - 8) {
+            b1 = q[p++];
+            if (b1 == 0xfe) {
+                px[0] = q[p++];
+                px[1] = q[p++];
+                px[2] = q[p++];
+            } else if (b1 == 0xff) {
+                for (i = 0; i != 4; i++) px[i] = q[p++];
+            } else if ((b1 & 0xc0) == 0x00) memcpy(px, index[b1], 4);
+            else if ((b1 & 0xc0) == 0x40) {
+                px[0] += ((b1 >> 4) & 3) - 2;
+                px[1] += ((b1 >> 2) & 3) - 2;
+                px[2] += (b1 & 3) - 2;
+            } else if ((b1 & 0xc0) == 0x80) {
+                b2 = q[p++];
+                vg = (b1 & 0x3f) - 32;
+                px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                px[1] += vg;
+                px[2] += vg - 8 + (b2 & 0x0f);
+            } else run = b1 & 0x3f;
+            memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+        } else return (0);
+        memcpy(ref + n * 4, px, 4);
+    }
+    return (p == len - 8); // all used up, nothing left but the end marker
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec + t.tv_nsec * 1e-9);
+}
+
+static unsigned int check(const char* name, const frame_t* f, unsigned int x0, unsigned int y0) {
+    // load back what writeqoi just wrote, and compare with want[] from x0,y0 on
+    unsigned int i, x, y, w, h, bad, refbad;
+    unsigned char* q;
+    q = malloc(sim_filelen);
+    memcpy(q, sim_file, sim_filelen);
+    i = sim_filelen;
+    bad = refbad = 0;
+    if ((refdecode(q, i, &w, &h) == 0) || (w != f->width) || (h != f->height)) refbad = 1;
+    else
+        for (y = 0; y != h; y++)
+            for (x = 0; x != w; x++)
+                if (rgbto16(ref[(y * w + x) * 4], ref[(y * w + x) * 4 + 1], ref[(y * w + x) * 4 + 2]) != want[(y0 + y) * fw + x0 + x]) refbad++;
+    free(q);
+    if (loadqoi("x.qoi", 1) || (avi_width != f->width) || (avi_height != f->height)) bad = 1;
+    else
+        for (y = 0; y != h; y++)
+            for (x = 0; x != w; x++)
+                if (cambuffer_s[y * w + x] != want[(y0 + y) * fw + x0 + x]) bad++;
+    if (bad || refbad) printf("%s : %d pixels wrong from loadqoi, %d from reference decoder\n", name, bad, refbad);
+    return (bad || refbad);
+}
+
+static unsigned int bench(unsigned int format, unsigned int noise, unsigned int reps) {
+    frame_t f, b;
+    unsigned int i, qlen, blen, fails;
+    double t, tq, tb, tc;
+    const char* fmt = ((format & 3) == img_mono) ? "mono" : ((format & 3) == img_rgb565) ? "RGB565" : "RGB888";
+
+    makeframe(&f, format, noise);
+    for (i = 0, tq = 0; i != reps; i++) {
+        fptr = FSfopen("x.qoi", FS_WRITE);
+        t = now();
+        if (writeqoi(&f) == 0) printf("writeqoi failed\n");
+        tq += now() - t;
+    }
+    qlen = sim_filelen;
+    fails = check(fmt, &f, 0, 0);
+
+    for (i = 0, tb = 0; i != reps; i++) { // as the camera app does it
+        fptr = FSfopen("x.bmp", FS_WRITE);
+        t = now();
+        if (writebmp(&f) == 0) printf("writebmp failed\n");
+        tb += now() - t;
+    }
+    blen = sim_filelen;
+    memcpy(bmp, sim_file, blen);
+    if (memcmp(src, f.pixels, sizeof (src))) printf("%s : writebmp changed the frame\n", fmt), fails++;
+    i = fw * fh * (format & 3);
+    printf("%-6s %-5s QOI %6d bytes %6.1f MB/s   BMP %6d bytes %6.1f MB/s   QOI is %3d%% of BMP\n", fmt, noise ? "noisy" : "clean",
+            qlen, i * reps / tq / 1e6, blen, i * reps / tb / 1e6, qlen * 100 / blen);
+    if ((format & 3) != img_rgb565) return (fails);
+
+    for (i = 0, tc = 0; i != reps; i++) { // converting the whole frame first
+        memcpy(work, src, sizeof (src));
+        b = f;
+        b.pixels = work;
+        fptr = FSfopen("x.bmp", FS_WRITE);
+        t = now();
+        conv16_24(&b);
+        writebmp(&b);
+        tc += now() - t;
+    }
+    if ((sim_filelen != blen) || memcmp(sim_file, bmp, blen)) printf("%s : BMP differs from conv16_24 then writebmp\n", fmt), fails++;
+    i = fw * fh * 2;
+    printf("%-6s %-5s                               conv16_24+BMP  %6.1f MB/s\n", fmt, noise ? "noisy" : "clean", i * reps / tc / 1e6);
+    return (fails);
+}
+
+static unsigned int bmpcheck(unsigned int format, unsigned int x0, unsigned int y0, unsigned int w, unsigned int h) {
+    // writebmp of an RGB565 frame, which converts as it goes, against writing it after conv16_24 on a packed copy
+    frame_t f, b;
+    unsigned int y, len;
+    makeframe(&f, format, 1);
+    frame_crop(&f, &f, x0, y0, w, h);
+    fptr = FSfopen("x.bmp", FS_WRITE);
+    if (writebmp(&f) == 0) return (printf("writebmp %dx%d failed\n", w, h), 1);
+    len = sim_filelen;
+    memcpy(bmp, sim_file, len);
+    b = f;
+    b.pixels = work;
+    b.stride = w * 2; // conv16_24 can't widen lines in place if they're spaced out
+    for (y = 0; y != h; y++) memcpy(work + y * b.stride, f.pixels + y * f.stride, b.stride);
+    conv16_24(&b);
+    fptr = FSfopen("x.bmp", FS_WRITE);
+    writebmp(&b);
+    if ((b.format & 3) != img_rgb888) return (printf("conv16_24 %dx%d didn't convert\n", w, h), 1);
+    if ((sim_filelen != len) || memcmp(sim_file, bmp, len)) return (printf("BMP %dx%d format %d differs from conv16_24 then writebmp\n", w, h, format), 1);
+    return (0);
+}
+
+int main(int argc, char** argv) {
+    unsigned int i, reps, fails;
+    frame_t f;
+    reps = 200;
+    for (i = 1; i < (unsigned int) argc; i++) {
+        if (!strcmp(argv[i], "-n") && (i + 1 < (unsigned int) argc)) reps = atoi(argv[++i]);
+        else {
+            printf("usage : qoibench [-n repeats]\n");
+            return (2);
+        }
+    }
+    if (reps == 0) reps = 1;
+
+    fails = 0;
+    for (i = 0; i != 4; i++) fails += bench((i & 2) ? img_rgb565 : img_mono, i & 1, reps);
+
+    makeframe(&f, img_rgb565 | img_revscan, 1); // bottom-up frames come out top down
+    fptr = FSfopen("x.qoi", FS_WRITE);
+    fails += !writeqoi(&f) || check("RGB565 revscan", &f, 0, 0);
+    makeframe(&f, img_rgb888, 1);
+    fptr = FSfopen("x.qoi", FS_WRITE);
+    fails += !writeqoi(&f) || check("RGB888", &f, 0, 0);
+    makeframe(&f, img_mono | img_revscan, 1);
+    frame_crop(&f, &f, 13, 17, 37, 23); // stored line 17 of a bottom-up frame is image line fh-1-17
+    fptr = FSfopen("x.qoi", FS_WRITE);
+    fails += !writeqoi(&f) || check("mono crop", &f, 13, fh - 17 - 23);
+    fails += bmpcheck(img_rgb565, 0, 0, fw, fh);
+    fails += bmpcheck(img_rgb565 | img_revscan, 0, 0, fw, fh);
+    for (i = 1; i != 6; i++) fails += bmpcheck(img_rgb565 | (i & 1) * img_revscan, i * 7, i * 3, 40 + i, 50 - i * 5); // line padding, odd sizes
+
+    sim_file[0] = 'Q'; // not QOI
+    i = loadqoi("x.qoi", 1);
+    if (i != 15) printf("bad magic : loadqoi returned %d\n", i), fails++;
+    memcpy(sim_file, "qoif\0\0\1\0\0\0\1\0\3\0", 14); // 256x256 doesn't fit in cambuffer as RGB565
+    i = loadqoi("x.qoi", 1);
+    if (i != 9) printf("too big : loadqoi returned %d\n", i), fails++;
+    sim_filelen = 20; // truncated
+    memcpy(sim_file, "qoif\0\0\0\10\0\0\0\10\3\0\376\1\2\3\376\1", 20);
+    i = loadqoi("x.qoi", 1);
+    if (i != 2) printf("truncated : loadqoi returned %d\n", i), fails++;
+
+    printf("%d failed\n", fails);
+    return (fails ? 1 : 0);
+}
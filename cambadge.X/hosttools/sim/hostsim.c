@@ -0,0 +1,98 @@
+// RAM file system, display and test scene stand-ins shared by the host tools that build fileformats.c. See hostsim.h
+
+#include "../../cambadge.h"
+#include "../../globals.h"
+#include "hostsim.h"
+#include <stdlib.h>
+#include <string.h>
+
+unsigned char sim_file[sim_filemax];
+unsigned int sim_filelen, sim_filepos;
+void (*sim_readhook)(void* p, size_t len);
+void (*sim_seekhook)(void);
+static FSFILE dummy;
+
+FSFILE* FSfopen(const char* name, const char* mode) {
+    (void) name;
+    if (strcmp(mode, FS_READ)) sim_filelen = 0;
+    sim_filepos = 0;
+    return (&dummy);
+}
+
+int FSfclose(FSFILE* f) {
+    (void) f;
+    return (0);
+}
+
+size_t FSfread(void* p, size_t size, size_t n, FSFILE* f) {
+    (void) f;
+    if (n * size > sim_filelen - sim_filepos) n = (sim_filelen - sim_filepos) / size;
+    if (sim_readhook) sim_readhook(p, n * size);
+    memcpy(p, sim_file + sim_filepos, n * size);
+    sim_filepos += n * size;
+    return (n);
+}
+
+size_t FSfwrite(const void* p, size_t size, size_t n, FSFILE* f) {
+    (void) f;
+    if (sim_filepos + n * size > sim_filemax) return (0);
+    memcpy(sim_file + sim_filepos, p, n * size);
+    sim_filepos += n * size;
+    if (sim_filepos > sim_filelen) sim_filelen = sim_filepos;
+    return (n);
+}
+
+int FSfseek(FSFILE* f, long offset, int whence) {
+    (void) f;
+    sim_filepos = (whence == SEEK_END) ? sim_filelen + offset : (whence == SEEK_CUR) ? sim_filepos + offset : offset;
+    if (sim_seekhook) sim_seekhook();
+    return (0);
+}
+
+long FSftell(FSFILE* f) {
+    (void) f;
+    return (sim_filepos);
+}
+
+int FSfeof(FSFILE* f) {
+    (void) f;
+    return (sim_filepos >= sim_filelen);
+}
+
+__attribute__((weak)) void dispimage(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format,
+        unsigned char* imgaddr) {
+    (void) xstart, (void) ystart, (void) xsize, (void) ysize, (void) format, (void) imgaddr;
+}
+
+__attribute__((weak)) void dispscaled(unsigned int xstart, unsigned int ystart, unsigned int xsize, unsigned int ysize, unsigned int format,
+        unsigned char* imgaddr, unsigned int srcw, unsigned int srch, unsigned int stride) {
+    (void) xstart, (void) ystart, (void) xsize, (void) ysize, (void) format, (void) imgaddr, (void) srcw, (void) srch, (void) stride;
+}
+
+__attribute__((weak)) void monopalette(unsigned int min, unsigned int max) {
+    (void) min, (void) max;
+}
+
+__attribute__((weak)) void oled_wait(void) {
+}
+
+void sim_scene(unsigned char* rgb, unsigned int w, unsigned int h, unsigned int n, unsigned int noise) {
+    unsigned int x, y, r, g, b;
+    srand(n);
+    for (y = 0; y != h; y++)
+        for (x = 0; x != w; x++) {
+            r = x * 2;
+            g = y * 2 + n * 3;
+            b = 128 + ((x + y) & 63);
+            if ((x >= 20 + n % 64) && (x < 60 + n % 64) && (y >= 30) && (y < 70)) r = g = b = 240; // box
+            if ((y >= h - 16) && (x & 2)) r = g = b = 20; // stripes
+            if (noise) {
+                r += rand() % noise;
+                g += rand() % noise;
+                b += rand() % noise;
+            }
+            *rgb++ = r;
+            *rgb++ = g;
+            *rgb++ = b;
+        }
+}
@@ -0,0 +1,22 @@
+// shared stand-ins for host builds of fileformats.c ( qoibench, mjpegbench, avisim), in hostsim.c
+// There's one file, in RAM, whatever the name. The display functions do nothing, and are weak so a tool can supply its own
+
+#ifndef hostsim_h
+#define hostsim_h
+
+#include <stddef.h>
+
+#define sim_filemax (8 << 20) // biggest file, bytes
+
+extern unsigned char sim_file[sim_filemax];
+extern unsigned int sim_filelen, sim_filepos;
+
+extern void (*sim_readhook)(void* p, size_t len); // if set, called by FSfread with where len bytes are about to go
+extern void (*sim_seekhook)(void); // if set, called by FSfseek
+
+void sim_scene(unsigned char* rgb, unsigned int w, unsigned int h, unsigned int n, unsigned int noise);
+// test scene into rgb, 3 bytes per pixel r,g,b, top line first : gradients, a sharp-edged box at x=20+n%64, and fine
+// stripes along the bottom, so there's something for every encoder. frame n moves the box and green gradient along,
+// and noise>0 adds 0..noise-1 to each channel, from rand() seeded with n
+
+#endif
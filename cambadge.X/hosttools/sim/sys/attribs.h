@@ -0,0 +1,2 @@
+// host stand-in for <sys/attribs.h> - ISRs become ordinary functions, called by capsim
+#define __ISR(v,...)
@@ -0,0 +1,3 @@
+// host stand-in for <sys/kmem.h> - host pointers are mapped to a fake PIC32 physical address space by capsim
+unsigned int sim_pa(const volatile void* p);
+#define KVA_TO_PA(v) sim_pa((const volatile void*)(v))
@@ -0,0 +1,94 @@
+// host stand-in for <xc.h>, used by capsim to build interrupts.c on a PC
+// only the SFRs the capture ISRs touch are here. They are plain variables, with the
+// xxxSET/CLR/INV aliases logged by sim_wr() and applied in order by sim_flush(), so
+// e.g. "IEC0CLR=m; IEC0SET=m;" inside an ISR does the same as on the chip.
+// DCHxCONbits alias their registers, through a union. DMA transfers are instantaneous so CHBUSY always reads 0.
+// Other bitfield views are dummies that don't alias the registers, as setupints() isn't modelled.
+
+#ifndef capsim_xc_h
+#define capsim_xc_h
+
+#include <stdint.h>
+
+#define sim_op_set 1
+#define sim_op_clr 2
+#define sim_op_inv 3
+
+volatile unsigned int* sim_wr(volatile unsigned int* reg, unsigned int op); // log a SET/CLR/INV write, returns where to put the value
+void sim_flush(void); // apply logged writes
+
+#define simreg(r) extern volatile unsigned int r;
+
+typedef struct {
+    unsigned CHPRI : 2, CHEDET : 1, : 1, CHAEN : 1, CHCHN : 1, CHAED : 1, CHEN : 1, CHCHNS : 1, : 6, CHBUSY : 1, : 16;
+} sim_dchconbits;
+typedef union { unsigned int w; sim_dchconbits bits; } sim_dchcon;
+extern volatile sim_dchcon sim_dch0con, sim_dch1con;
+#define DCH0CON sim_dch0con.w
+#define DCH1CON sim_dch1con.w
+extern volatile unsigned long TMR4; // long, so _ms_isr's clockfreq sum, unsigned long on a 64-bit host, isn't truncated
+
+simreg(DMACON) simreg(DCH0ECON) simreg(DCH0INT) simreg(DCH0SSA) simreg(DCH0DSA)
+simreg(DCH0SSIZ) simreg(DCH0DSIZ) simreg(DCH0CSIZ)
+simreg(DCH1ECON) simreg(DCH1INT) simreg(DCH1SSA) simreg(DCH1DSA)
+simreg(DCH1SSIZ) simreg(DCH1DSIZ) simreg(DCH1CSIZ)
+simreg(IFS0) simreg(IFS1) simreg(IEC0) simreg(IEC1) simreg(INTCON)
+simreg(PR3) simreg(TMR3) simreg(PMDIN) simreg(LATC) simreg(U2RXREG)
+
+#define DMACONSET (*sim_wr(&DMACON, sim_op_set))
+#define DMACONCLR (*sim_wr(&DMACON, sim_op_clr))
+#define DCH0CONSET (*sim_wr(&DCH0CON, sim_op_set))
+#define DCH0CONCLR (*sim_wr(&DCH0CON, sim_op_clr))
+#define DCH0INTSET (*sim_wr(&DCH0INT, sim_op_set))
+#define DCH0INTCLR (*sim_wr(&DCH0INT, sim_op_clr))
+#define DCH1CONSET (*sim_wr(&DCH1CON, sim_op_set))
+#define DCH1CONCLR (*sim_wr(&DCH1CON, sim_op_clr))
+#define DCH1INTSET (*sim_wr(&DCH1INT, sim_op_set))
+#define DCH1INTCLR (*sim_wr(&DCH1INT, sim_op_clr))
+#define IFS0SET (*sim_wr(&IFS0, sim_op_set))
+#define IFS0CLR (*sim_wr(&IFS0, sim_op_clr))
+#define IFS1SET (*sim_wr(&IFS1, sim_op_set))
+#define IFS1CLR (*sim_wr(&IFS1, sim_op_clr))
+#define IEC0SET (*sim_wr(&IEC0, sim_op_set))
+#define IEC0CLR (*sim_wr(&IEC0, sim_op_clr))
+#define IEC1SET (*sim_wr(&IEC1, sim_op_set))
+#define IEC1CLR (*sim_wr(&IEC1, sim_op_clr))
+#define INTCONSET (*sim_wr(&INTCON, sim_op_set))
+#define LATCINV (*sim_wr(&LATC, sim_op_inv))
+
+// IRQ bits, PIC32MX1xx/2xx numbering
+#define _IFS0_INT1IF_MASK (1<<8)
+#define _IFS0_T4IF_MASK (1<<19)
+#define _IFS0_INT4IF_MASK (1<<23)
+#define _IEC0_INT1IE_MASK (1<<8)
+#define _IEC0_T4IE_MASK (1<<19)
+#define _IEC0_INT4IE_MASK (1<<23)
+#define _IEC0_AD1IE_MASK (1<<28)
+#define _IFS1_U2RXIF_MASK (1<<22)
+#define _IFS1_DMA0IF_MASK (1<<28)
+#define _IFS1_DMA1IF_MASK (1<<29)
+#define _IEC1_U2RXIE_MASK (1<<22)
+#define _IEC1_DMA0IE_MASK (1<<28)
+#define _IEC1_DMA1IE_MASK (1<<29)
+#define _INTCON_MVEC_MASK (1<<12)
+
+#define DCH0CONbits sim_dch0con.bits
+#define DCH1CONbits sim_dch1con.bits
+typedef struct { unsigned INT1IE, INT4IE, T4IE, U2RXIE, DMA0IE, DMA1IE; } sim_iecbits;
+typedef struct { unsigned INT1IF, INT4IF, T4IF, U2RXIF, DMA0IF, DMA1IF; } sim_ifsbits;
+typedef struct { unsigned INT1IP, INT4IP, T4IP, U2IP, DMA0IP, DMA1IP, DMA2IP; } sim_ipcbits;
+typedef struct { unsigned INT1EP, INT4EP, MVEC; } sim_intconbits;
+typedef struct { unsigned URXDA; } sim_uxstabits;
+
+extern volatile sim_iecbits IEC0bits, IEC1bits;
+extern volatile sim_ifsbits IFS0bits, IFS1bits;
+extern volatile sim_ipcbits IPC1bits, IPC4bits, IPC9bits, IPC10bits;
+extern volatile sim_intconbits INTCONbits;
+extern volatile sim_uxstabits U2STAbits;
+
+extern unsigned int sim_coretimer; // stands in for the core timer, for isrtiming builds
+#define _CP0_GET_COUNT() (sim_coretimer)
+#define __builtin_enable_interrupts()
+#define Nop()
+
+#endif
@@ -15,10 +15,21 @@
 #define bufstart 8
 #define linelength 129
 
+#define exp_auto 0 // exposure modes for but2
+#define exp_lock 1
+#define exp_soft 2 // software AEC and auto contrast from capture histogram
+
+void fxpalette(unsigned short* hist, unsigned int expmode) { // palette for mono effects
+    if (expmode != exp_soft) monopalette(0, 255);
+    else if (hist) cam_autocontrast(hist, 2, 98);
+}
+
 char* imagefx(unsigned int action) {
     static unsigned int state, effect, page, val1, val2;
     unsigned int x, y, i, d, r, g, b,e,f;
     static unsigned char explock;
+    unsigned short* hist;
+    frame_t frame, view;
 
 
     switch (action) {
@@ -31,6 +42,8 @@ char* imagefx(unsigned int action) {
             effect = 0;
             cam_enable(cammode_128x96_z1_mono);
             cam_grabenable(camen_grab, bufstart - 1, 0);
+            cam_histenable(2);
+            if (explock == exp_soft) cam_aec(exp_soft);
             page = 1;
             val1 = val2 = 0;
 
@@ -48,8 +61,8 @@ char* imagefx(unsigned int action) {
     }
     
      if (butpress & but2) {
-                explock ^= 1;
-                cam_setreg(0x13, explock ? 0xe0 : 0xe7);
+                if (++explock > exp_soft) explock = exp_auto;
+                cam_aec(explock);
                
               
             }
@@ -63,17 +76,26 @@ char* imagefx(unsigned int action) {
 
         case s_run:
             if (!cam_newframe) break;
+            cam_frame(&frame, cambuffer + bufstart);
+            hist = cam_gethist();
+            if (hist && (explock == exp_soft)) cam_aecupdate(hist, 112);
             printf(tabx9 taby12 butcol);
-          if (explock) printf(inv "ExLock" inv);
-            else printf("ExLock");
+            switch (explock) {
+                case exp_auto: printf("ExLock");
+                    break;
+                case exp_lock: printf(inv "ExLock" inv);
+                    break;
+                case exp_soft: printf(inv "SwAEC " inv);
+            }
             printf(tabx0 taby11 yel);
             switch (effect) {
 
                 case 0: // update one line per frame
                     printf("Slowscan");
-                    monopalette(0, 255);
+                    fxpalette(hist, explock);
                     plotblock(0, 11 + ypixels - val1, xpixels, 1, c_grn);
-                    dispimage(0, 12 + ypixels - val1, xpixels, 1, (img_mono | img_revscan), cambuffer + bufstart + val1 * xpixels);
+                    frame_crop(&view, &frame, 0, val1, frame.width, 1);
+                    dispframe(0, 12 + ypixels - val1, view.width, 1, &view, 0);
                     if (++val1 == ypixels - 1) val1 = 0;
 
                     break;
@@ -100,11 +122,11 @@ char* imagefx(unsigned int action) {
 
                 case 3: // use camera capture start parameters to de-stabilise
                     printf("Unstabilise");
-                    monopalette(0, 255);
+                    fxpalette(hist, explock);
                     xstart = 30 + randnum(-15, 15);
                     ystart = 30 + randnum(-15, 15);
 
-                    dispimage(0, 12, xpixels, ypixels, (img_mono | img_revscan), cambuffer + bufstart);
+                    dispframe(0, 12, frame.width, frame.height, &frame, 0);
 
                     break;
                     unsigned char * inptr,*outptr;
@@ -142,7 +164,7 @@ char* imagefx(unsigned int action) {
             }///y
             
                     monopalette (0,255);
-                    dispimage(0, 12, xpixels, ypixels, (img_mono | img_revscan), cambuffer+bufstart);
+                    dispframe(0, 12, frame.width, frame.height, &frame, 0);
                     break;
                     
                 default: effect = 0;
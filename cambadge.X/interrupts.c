@@ -9,6 +9,20 @@
 
 
  unsigned int lineskip,cambufptr;
+ unsigned int linestepcnt,lineqaddr,lineqline; // line queue batch in progress
+ unsigned int linebytes,tmr3lat; // bytes per captured line, T3 preload for start of active part of line
+ unsigned char chainlat; // =1 if this frame uses chained DMA capture
+ unsigned int camlinetab[camlinetab_len]; // chained DMA : physical destination address of each line after the first, copied to DCH0DSA by DMA1
+ unsigned int histstepcnt; // lines until next histogram line
+ unsigned short histwork[camhist_bins]; // histogram being accumulated for current frame
+
+#if isrtiming==1 // core timer measures ISR time - doesn't include entry/exit overhead but good enough for comparisons
+#define isrstart unsigned int isrt=_CP0_GET_COUNT();
+#define isrend(m) isrt=_CP0_GET_COUNT()-isrt; if(isrt>m) m=isrt;
+#else
+#define isrstart
+#define isrend(m)
+#endif
  unsigned int xstartlat,xdivlat,ydivlat,xpixlat,ypixlat; // latched versions of camera parameters, sampled at vsync
 volatile uint32_t systick_ms = 0;
 
@@ -33,17 +47,44 @@ volatile uint32_t systick_ms = 0;
 
 void __ISR(_EXTERNAL_4_VECTOR,IPL7SOFT) vsint(void)
 { // camera vertical sync - set everything up for grabbing a new frame
+    unsigned int i;
+    static unsigned int lastvs;
     systick_ms += 20;  // comes in every ~20ms
 
+    i=_CP0_GET_COUNT(); // sensor frame time, so apps can compare to achieved rate
+    cam_vsperiod=i-lastvs;
+    lastvs=i;
+
     IFS0CLR=_IFS0_INT4IF_MASK;
     DCH0CON=0b0000000000000000; // DMA channel disable (in case overflow from previous frame)
     while(DCH0CONbits.CHBUSY); // ensure any pending DMAs from overflowed previous frame finished. Assumes DMA1 done if DMA0 is
+    DCH1CON=0; // stop any line address reload from previous frame
+    IEC1CLR=_IEC1_DMA1IE_MASK;
 
     cam_busy=1; // status flags
     if(!cam_wrap) cam_started=1; // force start to avoid FG task stalling if no transfer occurs due to bad parameters
     cam_wrap=0;
     cambufptr=camoffset;
     linecnt=0;
+    linestepcnt=cam_linestep;
+    histstepcnt=0;
+    if(cam_histstep) for(i=0;i!=camhist_bins;i++) histwork[i]=0;
+
+    if(camring) { // pick a free slot in the frame ring
+        if(cam_slot!=camslot_none) cam_drops++; // previous frame incomplete - re-use its slot
+        else {
+            for(i=0;i!=cam_nslots;i++) if(cam_slotstate[i]==camslot_free) break;
+            if(i==cam_nslots) { // all slots busy - drop this frame
+                cam_drops++;
+                cam_busy=0;
+                IEC0CLR=_IEC0_INT1IE_MASK;
+                return;
+            }
+            cam_slot=i;
+            cam_slotstate[i]=camslot_filling;
+        }
+        cambufptr=cam_slotaddr[cam_slot];
+    }
 
     //latch all parameters for next frame
     lineskip=ystart;xstartlat=xstart; ydivlat=ydiv;xpixlat=xpixels;ypixlat=ypixels;
@@ -73,6 +114,43 @@ void __ISR(_EXTERNAL_4_VECTOR,IPL7SOFT) vsint(void)
     DCH0ECON=14<<8 | 1<<4;      // DMA trigger source for odd pixels : 14=Timer 3 , enable irq to start transfer
 
 
+    linebytes=(camflags & camopt_mono)?xpixlat:xpixlat*2;
+    tmr3lat=-xstartlat*2-1; // timer offset to start of active part of line
+
+#if camchaindma==1
+    // chained capture : DMA0 completion triggers DMA1, which copies the next line's destination from camlinetab into DCH0DSA
+    // while DMA0 is idle, so hsync only has to restart DMA0 and there's no per-line DMA int.
+    // Only used if nobody wants to know about each line as it arrives.
+    chainlat=(cam_linestep==0) && (cam_histstep==0) && (ypixlat<=camlinetab_len) && (ypixlat>1);
+#else
+    chainlat=0;
+#endif
+    if(chainlat) {
+        i=cambufptr;
+        DCH0DSA=KVA_TO_PA(&cambuffer[i]); // first line
+        for(linecnt=0;linecnt!=ypixlat-1;linecnt++) { // pre-compute the rest, including wrap
+            i+=linebytes;
+            if(i>=cammax) i=camoffset;
+            camlinetab[linecnt]=KVA_TO_PA(&cambuffer[i]);
+        }
+        camlinetab[linecnt]=DCH0DSA; // dummy load after last line, DMA0 gets stopped by end of frame int before next line
+        linecnt=0;
+        camaddr=i; // last line, as that's where it'll be at end of frame
+        DCH0INT=1<<21; // flag on done - needed to trigger DMA1, but not enabled as a CPU int
+        IEC1CLR=_IEC1_DMA0IE_MASK;
+
+        DCH1SSA=KVA_TO_PA(camlinetab);
+        DCH1SSIZ=ypixlat*4; // block complete, and end of frame int, after last line
+        DCH1DSA=KVA_TO_PA((void*)&DCH0DSA);
+        DCH1DSIZ=4;
+        DCH1CSIZ=4; // one address per DMA0 completion
+        DCH1ECON=60<<8 | 1<<4; // trigger on 60=DMA0 IRQ
+        DCH1INT=1<<19; // int on block complete = end of frame
+        IFS1CLR=_IFS1_DMA1IF_MASK;
+        IEC1SET=_IEC1_DMA1IE_MASK;
+        DCH1CON=0b0000000010000011; // enable, priority 3
+    }
+
     IEC0CLR=_IEC0_INT1IE_MASK; // clear hsync int
     IEC0SET=_IEC0_INT1IE_MASK; // enable hsync int
 }
@@ -82,47 +160,139 @@ void __ISR(_EXTERNAL_4_VECTOR,IPL7SOFT) vsint(void)
 
 void __ISR(_EXTERNAL_1_VECTOR,IPL6SOFT) hsint(void)
 { //camera horizontal sync int, occurs at end of line so pixel clock is not active
-     unsigned int i;
 
     IFS0CLR=_IFS0_INT1IF_MASK;
 
+    if(DCH0CONbits.CHEN) { // last line's DMA still going, so line is longer than sensor row - abandon frame
+        DCH0CON=0;DCH1CON=0;
+        IEC1CLR=_IEC1_DMA0IE_MASK | _IEC1_DMA1IE_MASK;
+        IEC0CLR=_IEC0_INT1IE_MASK;
+        cam_busy=0; // so cam_grabdisable doesn't wait for a frame that won't finish
+        return;
+    }
     if(lineskip--) return; // ignore lines for Y scaling
+    isrstart
      lineskip=ydivlat-1;
+     TMR3=tmr3lat;  // timer offset to start of active part of line
+
+     if(chainlat) { // destination already loaded by DMA1
+         DCH0INTCLR=0xff; // clear done flag so next completion triggers DMA1
+         IFS1CLR=_IFS1_DMA0IF_MASK;
+         DCH0CONSET=0b0000000010000011; // DMA channel enable, priority 3 so display DMA can't get between PMP reads
+         if(!cam_wrap) {cam_wrap=1;cam_started=1;} // first line
+         isrend(cam_hsmax)
+         return;
+     }
 
      if(linecnt==0) {cam_wrap=1;cam_started=1;} // set flags on first line to tell FG task capture has started
-     i=-xstartlat*2;
-     TMR3=i-1;  // timer offset to start of active part of line
 
      DCH0CON=0b0000000000000000; // DMA channel disable (in case overrun from last due to bad parameters)
      while(DCH0CONbits.CHBUSY); // wait for any overrun to stop
      DCH0DSA=KVA_TO_PA(&cambuffer[cambufptr]); // destination address
-     DCH0CON=0b0000000010000000; // DMA channel enable
+     DCH0CON=0b0000000010000011; // DMA channel enable, priority 3
 
      DCH0INTCLR=0xff; // clear any pending DMA ints
      IFS1CLR=_IFS1_DMA0IF_MASK;
      IEC1SET=_IEC1_DMA0IE_MASK; // enable dma-complete int
+     isrend(cam_hsmax)
+}
+
+void camframedone(void)
+{ // all lines captured - used by line DMA int, or end of frame int for chained capture
+    IEC0CLR=_IEC0_INT1IE_MASK; //     kill Hsync int
+    cam_busy=0;cam_newframe=1;
+
+    if(cam_histstep) { // publish histogram
+        unsigned int i,n;
+        for(i=n=0;i!=camhist_bins;i++) n+=(cam_hist[i]=histwork[i]);
+        cam_histtotal=n;
+        cam_histready=1;
+    }
+
+    if(cam_slot!=camslot_none) { // hand completed slot to FG task
+        cam_slotseq[cam_slot]=++cam_frameseq;
+        cam_slottime[cam_slot]=_CP0_GET_COUNT();
+        cam_slotstate[cam_slot]=camslot_ready;
+        cam_slot=camslot_none;
+    }
+
+    if(cam_stop) IEC0CLR = _IEC0_INT4IE_MASK; //
+}
+
+void cam_grablayout(unsigned int opt,unsigned int bufoffset,unsigned int cambuflen)
+{ // where the ISRs put each frame, for cam_grabenable. Grab must be disabled. Here rather than hardware.c so capsim tests it
+    unsigned int i;
+    cam_stop=(opt==camen_grab)?1:0;
+    camoffset=bufoffset;
+    cammax=cambuflen;
+    camring=0;
+    i=xpixels*((camflags&camopt_mono)?1:2);
+    if(opt==camen_ring) { // cambuflen is slot length, fit as many slots as possible up to camring_maxslots
+        for(cam_nslots=0;cam_nslots!=camring_maxslots;cam_nslots++) { // slots don't wrap, so only the last line's 2 byte overrun goes past the end
+            if(bufoffset+cambuflen*cam_nslots+cambuflen+2>cambufsize) break;
+            cam_slotaddr[cam_nslots]=bufoffset+cambuflen*cam_nslots;
+            cam_slotstate[cam_nslots]=camslot_free;
+        }
+        cam_frameseq=cam_drops=0;
+        cammax=0; // no wrap within slots
+        camring=1;
+    }
+    if((cammax==0)||(cammax>cambufsize-i)) cammax=cambufsize-i; // wrap mode : add margin so we don't need to worry about line length
 }
 
 //------------------------------------------------------------ dma complete int
 
 void __ISR(_DMA_0_VECTOR,IPL5SOFT) dmaint(void)
 { // DMA complete int - line of data received.
+    isrstart
 
     IFS1CLR=_IFS1_DMA0IF_MASK;
     IEC1CLR=_IEC1_DMA0IE_MASK;// disable DMA int
 
     camaddr=cambufptr; // for use by FG task if it wants to overlap cam grab and using data
-    cambufptr+=(camflags & camopt_mono)?xpixlat:xpixlat*2;
+
+    if(cam_histstep) if(histstepcnt--==0) { // histogram from line just landed
+        unsigned char *p=&cambuffer[camaddr+1];
+        unsigned int i;
+        histstepcnt=cam_histstep-1;
+        if(camflags & camopt_mono) for(i=0;i<linebytes;i+=camhist_xstep) histwork[p[i]>>2]++; // top 6 bits of Y
+        else for(i=0;i<linebytes;i+=camhist_xstep*2) histwork[(p[i+1] & 7)<<3 | p[i]>>5]++; // G of RGB565, little-endian
+    }
+    cambufptr+=linebytes;
     if(cambufptr>=cammax) cambufptr=camoffset; // wrap
 
- if(++linecnt==ypixlat) { // last line?
+    if(cam_linestep) { // line queue
+        if(linestepcnt==cam_linestep) {lineqaddr=camaddr;lineqline=linecnt;} // first line of batch
+        if((--linestepcnt==0) || (linecnt+1==ypixlat)) { // batch complete, or end of frame
+            linestepcnt=cam_linestep;
+            if(cam_lineqhead-cam_lineqtail<camlineq_len) {
+                cam_lineq[cam_lineqhead & (camlineq_len-1)]=lineqaddr | lineqline<<16; // single word so FG never sees half an entry
+                cam_lineqhead++;
+            }
+            else cam_lineqdrops++;
+        }
+    }
+
+ if(++linecnt==ypixlat) camframedone(); // last line?
+    isrend(cam_dmamax)
+}
 
-    IEC0CLR=_IEC0_INT1IE_MASK; //     kill Hsync int
-    cam_busy=0;cam_newframe=1;
+//------------------------------------------------------------ end of frame int for chained capture
 
-    if(cam_stop) IEC0CLR = _IEC0_INT4IE_MASK; //
+void __ISR(_DMA_1_VECTOR,IPL5SOFT) dma1int(void)
+{ // DMA1 has loaded the dummy address after the last line, so all lines are done
+    IFS1CLR=_IFS1_DMA1IF_MASK;
+    IEC1CLR=_IEC1_DMA1IE_MASK;
+    DCH1INTCLR=0xff;
+    linecnt=ypixlat;
+    camframedone();
+}
 
-   }
+//------------------------------------------------------------ display DMA
+
+void __ISR(_DMA_2_VECTOR,IPL2SOFT) oledint(void)
+{ // DMA2 has sent a line ( or whole image) to the OLED
+    oled_dmanext();
 }
 
 void __ISR(_TIMER_4_VECTOR,IPL6SOFT) _ms_isr(void)
@@ -157,6 +327,10 @@ void setupints(void)
     // line DMA complete, gets enabled by hsync int
     DCH0INT=1<<21; // int on done
     IPC10bits.DMA0IP=5;
+    IPC10bits.DMA1IP=5; // end of frame for chained capture
+
+    // display DMA block done, gets enabled per transfer. Lowest priority so capture is never held up
+    IPC10bits.DMA2IP=2;
     #if serialcontrol==1
     //Uart receive
     IPC9bits.U2IP=4;
@@ -74,6 +74,7 @@
 
 #define sram_cs_lo LATCCLR=1<<1 // shared with oled
 #define sram_cs_hi LATCSET=1<<1
+#define sram_size 0x20000 // 23LC1024 on SPI2, shared with SD card
 
 #define oledclk 12000000 // OLED SPI clock. must be (clockfreq/2)/integer
 #define oled_reset_time 50 //uS
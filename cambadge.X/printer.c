@@ -87,6 +87,7 @@ char* printer(unsigned int action)
     static unsigned int camfile = 0, camdir = 0, cam_cammode, frame;
     static unsigned int rectime, explock,campage;
     unsigned int i;
+    frame_t camframe;
 
     if (action == act_name) return ("Printer");
     else if (action == act_help) return ("Takes pictures and\nprints them!");
@@ -153,7 +154,8 @@ char* printer(unsigned int action)
             if (!cam_newframe) break;
             if (camflags & camopt_mono) monopalette(0, 255);
             cam_newframe = 0; // clear now in case display takes longer than cam frame time
-            dispimage(0, 12, xpixels, ypixels, (camflags & camopt_mono) ? (img_mono | img_revscan) : (img_rgb565 | img_revscan), cambuffer + 8);
+            cam_frame(&camframe, cambuffer + 8);
+            dispframe(0, 12, camframe.width, camframe.height, &camframe, 0);
             break;
 
         case s_avierr:
@@ -235,23 +237,10 @@ char* printer(unsigned int action)
             cam_grabenable(camen_grab,7+(campage?0:(avi_framelen+8)),0); // start grab to other page
             if (camflags & camopt_mono) monopalette(0, 255);
 
-            // add chunk header before image data
-            i=campage?(avi_framelen+8):0;
-            cambuffer[i++] = '0';
-            cambuffer[i++] = '0';
-            cambuffer[i++] = 'd';
-            cambuffer[i++] = 'c';
-            cambuffer[i++] = avi_framelen;
-            cambuffer[i++] = avi_framelen >> 8;
-            cambuffer[i++] = 0;
-            cambuffer[i++] = 0;
+            cam_frame(&camframe, cambuffer + (campage ? (avi_framelen + 8) : 0) + 8); // 8 bytes before image data for chunk header
+            dispframe(0, 12, camframe.width, camframe.height, &camframe, 0);
 
-            dispimage(0, 12, xpixels, ypixels, (camflags & camopt_mono) ? (img_mono | img_revscan) : (img_rgb565 | img_revscan), cambuffer + i);
-
-            if (avi_bpp == 1) flipcambuf(xpixels, ypixels, i); // mono AVIs have reverse scan direction
-
-
-            if (FSfwrite(&cambuffer[i-8], avi_framelen + 8, 1, fptr) == 0) {
+            if (writeaviframe(&camframe) == 0) { // flips & range-maps mono on the way out
                 printf(bot "Error:WriteFrame" del del);
                 FSfclose(fptr);
                 cam_grabdisable();
@@ -296,19 +285,12 @@ char* printer(unsigned int action)
                 if (i) FSfclose(fptr);
             } while (i);
 
-            if (!(camflags & camopt_mono)) conv16_24(xpixels * ypixels, 8); // RGB565 to 888
+            cam_frame(&camframe, cambuffer + 8);
 
             fptr = FSfopen(camname, FS_WRITE);
             FSchdir("\\"); // exit dir for easier tidyup if error
 
-            i = writebmpheader(xpixels, ypixels, (camflags & camopt_mono) ? 1 : 3);
-            if (i == 0) {
-                FSfclose(fptr);
-                printf("Err writing header" bot "OK");
-                camstate = s_camwait;
-                break;
-            }
-            i = FSfwrite(&cambuffer[8], xpixels * ypixels * ((camflags & camopt_mono) ? 1 : 3), 1, fptr);
+            i = writebmp(&camframe);
             FSfclose(fptr);
             if (i == 0) {
                 printf("Err writing image" bot "OK");
@@ -72,6 +72,16 @@ void __ISR(_ADC_VECTOR, IPL6SOFT) adcint(void) {
 #define xstart 0
 #define menus 6
 
+// waveform area is drawn into an 8bpp image and sent with img_diff, so only tiles the trace has moved through go to the display
+#define scopebuf (cambuffer + samples * 2) // after sample buffer
+#define pc_blk 0 // palette indices
+#define pc_grid 1
+#define pc_y1 2
+#define pc_y2 3
+#define pc_cya 4
+#define pc_whi 5
+#define pc_red 6
+
 char* scope(unsigned int action) {
     static unsigned int state;
     unsigned int i;
@@ -222,23 +232,23 @@ char* scope(unsigned int action) {
 
             for (x = xstart; x != 128; x++) {
 
-                plotblock(x, ystart, 1, yheight, ((x - xstart) % gridx) ? 0 : gridcol); //erase column/draw grid vert
+                mplotblock(x, 0, 1, yheight, ((x - xstart) % gridx) ? pc_blk : pc_grid, scopebuf); //erase column/draw grid vert
 
-                for (y = 0; y != yheight / gridy + 1; y++) plotblock(x, ystart + y * gridy, 1, 1, gridcol); //y lines 
-                if ((x - xstart) % (gridx / 2) == 0) plotblock(x, y1base, 1, 1, y1col); // y1 baseline
-                if ((x - xstart) % (gridx / 2) == gridx / 4) plotblock(x, y2base, 1, 1, y2col); // y2 baseline
-                if ((x - xstart) % (gridx / 2) == 2) plotblock(x, trigline, 1, 1, c_cya); // y2 baseline
-                c = y1col;
+                for (y = 0; y != yheight / gridy + 1; y++) mplotblock(x, y * gridy, 1, 1, pc_grid, scopebuf); //y lines 
+                if ((x - xstart) % (gridx / 2) == 0) mplotblock(x, y1base - ystart, 1, 1, pc_y1, scopebuf); // y1 baseline
+                if ((x - xstart) % (gridx / 2) == gridx / 4) mplotblock(x, y2base - ystart, 1, 1, pc_y2, scopebuf); // y2 baseline
+                if ((x - xstart) % (gridx / 2) == 2) mplotblock(x, trigline - ystart, 1, 1, pc_cya, scopebuf); // y2 baseline
+                c = pc_y1;
                 s = sampbuf[sp++];
                 s -= y1pos;
                 s = s * (signed int) yscales[y1range] / 65536;
                 if (s < 0) {
                     s = 0;
-                    c = c_whi;
+                    c = pc_whi;
                 }
                 if (s >= yheight - 1) {
                     s = yheight - 2;
-                    c = c_red;
+                    c = pc_red;
                 }
 
 
@@ -252,19 +262,19 @@ char* scope(unsigned int action) {
                 } // do vertical bar from last sample Y to this
                 if (h == 0) h = 1;
                 ly1 = s;
-                if (x > xstart) plotblock(x, y, 1, h, c); // simple fudge to avoid glitch moving to first point
+                if (x > xstart) mplotblock(x, y - ystart, 1, h, c, scopebuf); // simple fudge to avoid glitch moving to first point
 
-                c = y2col;
+                c = pc_y2;
                 s = sampbuf[sp++];
                 s -= y2pos;
                 s = s * (signed int) yscales[y2range] / 65536;
                 if (s < 0) {
                     s = 0;
-                    c = c_whi;
+                    c = pc_whi;
                 }
                 if (s >= yheight - 1) {
                     s = yheight - 2;
-                    c = c_red;
+                    c = pc_red;
                 }
 
                 s = (yheight - s) + ystart - 1; // flip co-ordinates
@@ -277,10 +287,19 @@ char* scope(unsigned int action) {
                 } // do vertical bar from last sample Y to this
                 if (h == 0) h = 1;
                 ly2 = s;
-                if (x > xstart) plotblock(x, y, 1, h, c); // simple fudge to avoid glitch moving to first point
+                if (x > xstart) mplotblock(x, y - ystart, 1, h, c, scopebuf); // simple fudge to avoid glitch moving to first point
 
             }
-            plotblock(127, ystart, 1, yheight, gridcol); //fudge RHS grid line
+            mplotblock(127, 0, 1, yheight, pc_grid, scopebuf); //fudge RHS grid line
+            oled_wait(); // palette may still be in use by last transfer
+            palette[pc_blk] = c_blk;
+            palette[pc_grid] = gridcol;
+            palette[pc_y1] = y1col;
+            palette[pc_y2] = y2col;
+            palette[pc_cya] = c_cya;
+            palette[pc_whi] = c_whi;
+            palette[pc_red] = c_red;
+            dispimage(0, ystart, 128, yheight, img_mono | img_diff, scopebuf);
 
             printf(top y1);
             if (menustate == 0) bgcol = menubg;
@@ -3,7 +3,7 @@
 #include "globals.h"
 
 char* settings(unsigned int action) {
-    unsigned int i, j, t;
+    unsigned int i, j, t, t2;
     static unsigned char tport, tbyte;
     static unsigned int u1rxcount;
     static unsigned char state = 0;
@@ -15,6 +15,12 @@ char* settings(unsigned int action) {
 #define s_twiddle 5
 #define s_speedtest 6
 #define s_stwait 7
+#define s_textbench 8
+#define s_textwait 9
+#define s_blitbench 10
+#define s_blitwait 11
+#define s_fontbench 12
+#define s_fontwait 13
 
 
     if (action == act_name) return ("UTILITIES");
@@ -40,7 +46,7 @@ char* settings(unsigned int action) {
             printf(tabx0 whi taby2 "X: %6d\nY: %6d\nZ:%6d\n\n", accx, accy, accz);
 
             if (butpress & but1) {
-                printf(cls top "EXIT" bot "Speedtest      Format");
+                printf(cls top "EXIT" bot "SDspeed Text   Format");
                 state = s_formwait;
                 break;
             }
@@ -67,6 +73,10 @@ char* settings(unsigned int action) {
                 state = s_speedtest;
                 break;
             }
+            if (butpress & but2) {
+                state = s_textbench;
+                break;
+            }
             if (butpress & but3) state = s_formwait2;
             else state = s_sstart;
             break;
@@ -78,6 +88,7 @@ char* settings(unsigned int action) {
                 break;
             }
             state = s_stwait;
+            dispconsole = 1; // results of each run scroll up, and can be scrolled back to
             
             printf(cls whi "Opening" tabx0);
             T5CON = 0b1000000001110000; // timer to measure grab+save time for playback framerate
@@ -113,16 +124,97 @@ char* settings(unsigned int action) {
 
             break;
         case s_stwait:
-            if (!tick) break;
+            if (butpress & but1) dispscrollback(1);
+            if (butpress & but2) dispscrollback(-1);
+            if (butpress & but3) {
+                dispconsole = 0;
+                state = s_sstart;
+            }
+            if (butpress & but4) if (cardmounted)state = s_speedtest;
+            if (!tick || dispscrollback(0)) break; // leave earlier runs in view
             printf(tabx0 taby11 whi "Card status: ");
-            if (cardmounted) printf("OK  " bot butcol "Repeat          Exit");
-            else printf("None " bot butcol "                Exit");
+            if (cardmounted) printf("OK  " tabx15 taby0 butcol "Repeat");
+            else printf("None " tabx15 taby0 butcol "      ");
+            printf(bot butcol uarr "      " darr "      Exit");
+            break;
+
+
+
+        case s_textbench: // text speed, a window per glyph vs a window per printf run
+#define tbstring "The quick brown fox!" // 20 glyphs
+#define tblines 5
+            printf(cls);
+            t = _CP0_GET_COUNT();
+            for (i = 0; i != tblines; i++) {
+                dispx = 0;
+                dispy = i * vspace;
+                for (j = 0; j != sizeof (tbstring) - 1; dispchar(tbstring[j++]));
+            }
+            oled_wait();
+            t = _CP0_GET_COUNT() - t;
+            t2 = _CP0_GET_COUNT();
+            for (i = 0; i != tblines; i++) printf("%c%c%s", 0x80, 0xa5 + i, tbstring);
+            oled_wait();
+            t2 = _CP0_GET_COUNT() - t2;
+            i = tblines * (sizeof (tbstring) - 1); // glyphs, each way
+            printf(tabx0 taby11 whi "Glyph %6d/s" tabx0 taby12 "Run   %6d/s", i * (clockfreq / 2) / t, i * (clockfreq / 2) / t2); // core timer is clockfreq/2
+            state = s_textwait;
+            break;
+
+        case s_textwait:
+            if (butpress) state = s_fontbench;
+            break;
+
+        case s_fontbench: // text pixel rate for each font, runs of tbstring or digits
+        {
+            const font_t* const fbfont[] = {&font6x8, &font12x16, &fontnum24x32};
+            const char* const fbtext[] = {tbstring, "Quick fox!", "12:34"}; // a line's worth in each
+            unsigned int fbrate[3];
+
+            printf(cls);
+            for (i = 0; i != 3; i++) {
+                dispfont(fbfont[i]);
+                t = _CP0_GET_COUNT();
+                for (j = 0; j != 3; j++) printf("%c%c%s", 0x80, 0xa0 + j * 4, fbtext[i]);
+                oled_wait();
+                t = _CP0_GET_COUNT() - t;
+                for (j = 0; fbtext[i][j]; j++);
+                fbrate[i] = 3 * j * fbfont[i]->width * fbfont[i]->height * ((clockfreq / 2) / 1000) / t; // K pixels/sec
+            }
+            dispfont(0);
+            printf(cls whi "Text Kpix/s\n6x8   %5d\n12x16 %5d\n24x32 %5d", fbrate[0], fbrate[1], fbrate[2]);
+            state = s_fontwait;
+            break;
+        }
 
-            if (butpress & but3) state = s_sstart;
-            if (butpress & but1) if (cardmounted)state = s_speedtest;
+        case s_fontwait:
+            if (butpress) state = s_blitbench;
             break;
 
+        case s_blitbench: // dispimage pixel rate per format, and share of each transfer the CPU spent converting lines
+#define bbpasses 4
+        {
+            const unsigned int bbformat[] = {img_rgb565, img_rgb565 | img_revscan, img_mono, img_mono | img_skip1, img_mono | img_vdouble, img_rgb888, img_rgb888 | img_skip1};
+            const char* const bbname[] = {"565", "565 rev", "mono", "mono sk1", "mono vdb", "888", "888 sk1"};
+            unsigned int bbrate[sizeof (bbformat) / 4], bbcpu[sizeof (bbformat) / 4];
+
+            monopalette(0, 255);
+            for (i = 0; i != sizeof (bbformat) / 4; i++) {
+                t = _CP0_GET_COUNT();
+                for (j = 0; j != bbpasses; j++) dispimage(0, 0, 128, 64, bbformat[i], cambuffer + 8);
+                t = _CP0_GET_COUNT() - t;
+                bbrate[i] = bbpasses * 128 * ((bbformat[i] & img_vdouble) ? 128 : 64) * ((clockfreq / 2) / 1000) / t; // K pixels/sec
+                bbcpu[i] = oled_xfertime ? oled_cputime * 100 / oled_xfertime : 0;
+            }
+            printf(cls whi "Format   Kpix/s CPU\n");
+            for (i = 0; i != sizeof (bbformat) / 4; i++) printf("%-8s %5d %3d%%\n", bbname[i], bbrate[i], bbcpu[i]);
+        }
+            state = s_blitwait;
+            break;
 
+        case s_blitwait:
+            if (butpress) state = s_sstart;
+            break;
 
         case s_formwait2:
             if (!(butpress & but4)) break;